@@ -12,6 +12,7 @@
 #include <set>
 #include <vector>
 #include <string>
+#include <memory>
 
 using namespace std;
 
@@ -20,25 +21,32 @@ using namespace std;
 typedef struct{
 	string name;	// motif's name.
 	double score;	// maximum score when as a single presence node.
-	double depth;	// current chosen functional depth.
+	int didx;		// index of current chosen functional depth in func_depths.
 } MotifScore;
 
-// Information of a single binding site.
+// Score of a motif pair as a network of its own: joint presence of both motifs, 
+// or distance or order of their sites.
 typedef struct{
-	char orien;		// Orientation.
-	double score;	// Matrix score.
-	int loc;		// Binding location.
-} GBinding;
-
-// A vector to contain all binding sites of a gene.
-struct VGB{
-	vector<GBinding> e;
+	string name0, name1;	// names of the two motifs.
+	double score;	// best score of the pair.
+	int didx0, didx1;	// indices of their functional depths in func_depths.
+	string desc;	// "pres" for joint presence, "dist" or "order".
+	int para;		// parameter of dist or order; -1 for joint presence.
+} PairScore;
+
+// Binding sites of one motif on all indexed genes, packed as compressed rows.
+// Sites of gene g occupy [off[g], off[g+1]) in "loc" and "bin".
+// Low 7 bits of "bin" count the functional depths that are not above the
+// site's matrix score, so a site passes depth index d if (bin & DEPBITS) > d.
+// The high bit is set for a site in reverse orientation.
+struct MotifBind{
+	vector<int> off;	// offsets of each gene's sites; one more than genes.
+	vector<int> loc;	// binding locations.
+	vector<unsigned char> bin;	// depth bin and orientation bit.
 };
 
-// A map to contain all genes' binding.
-struct GBMap{
-	map<string, VGB> e;
-};
+#define DEPBITS	0x7f	// mask for depth bin of a site.
+#define REVBIT	0x80	// bit for reverse orientation of a site.
 
 // Description of a constraint.
 typedef struct{
@@ -58,11 +66,19 @@ typedef struct{
 typedef struct{
 	string name;
 	int label;
+	int gi;		// index of the gene in binding store.
+	int wt;		// multiplicity of the case in CPT.
 } Case;
 
+// Shared binding of one motif; stays valid while held even if evicted.
+typedef shared_ptr<const MotifBind> BindPtr;
+
+// Genes satisfying one constraint, one bit for each indexed gene.
+typedef shared_ptr<const vector<unsigned long long> > ConsBits;
+
 // A map to contain motif binding
 struct MotifMap{
-	map<string, GBMap> e;
+	map<string, shared_ptr<MotifBind> > e;
 };
 
 // A structure to store prediction results
@@ -89,6 +105,15 @@ struct BSolu{
 	vector<MotifScore> mscor;
 };
 
+// Settings of one run that may differ between runs in parallel.
+struct RunConf{
+	double logK;
+	string rb;
+	int Repeat, Iteration, Changes;	// simulated annealing.
+	double Alpha, Initemp, DeterScor;
+	bool tagbests;
+};
+
 #endif
 
 
@@ -1,8 +1,12 @@
 /*	bayescor.cpp
 
-	1. Load a cluster's motif list, motifs' binding and gene lists into memory.
-	2. Run Bayesian network to learn presense for each motif individually.
+	1. Load a cluster's motif list and gene lists into memory.
+	2. Run Bayesian network to learn presense for each motif individually,
+	   loading and releasing each motif's binding on the thread pool.
 	3. Output the score for each motif.
+	With -pairs, every pair of motifs is scored instead and the top pairs are output.
+	With -cache, scores of motifs whose binding and settings are unchanged are reused.
+	The motif list can be split into shards scored by separate jobs and merged afterwards.
 */
 
 
@@ -10,19 +14,270 @@
 #include <fstream>
 #include <string>
 #include <sstream>
+#include <map>
+#include <set>
+#include <iomanip>
+#include <algorithm>
+#include <stdio.h>
 #include "bayesub.h"
 #include "globals.h"
 #include "CmdLine.h"
+#include "thrpool.h"
 
+// Merge the outputs of shards into the output of one job: the line of each motif 
+// is copied in the order of the motif list. Return 1 if a motif is missing, 
+// scored differently by two shards or not in the list.
+int mergescor(const vector<string>& motiflst, const vector<string>& shards, const string& o)
+{
+	map<string, string> lines;	// line of each motif.
+	for(size_t i = 0; i < shards.size(); i++)
+	{
+		ifstream h(shards[i].data());
+		if(!h)
+		{
+			cerr << "Can't open " << shards[i] << endl;
+			return 1;
+		}
+		string strLn;
+		while(getline(h, strLn))
+		{
+			if(strLn == "")
+				continue;
+			istringstream strmLn(strLn);
+			string motif;
+			strmLn >> motif;
+			map<string, string>::const_iterator k = lines.find(motif);
+			if(k != lines.end() && k->second != strLn)
+			{
+				cerr << "Motif " << motif << " has different scores in shards!" << endl;
+				return 1;
+			}
+			lines[motif] = strLn;
+		}
+	}
+	set<string> motifs(motiflst.begin(), motiflst.end());
+	for(map<string, string>::const_iterator k = lines.begin(); k != lines.end(); k++)
+	{
+		if(motifs.find(k->first) == motifs.end())
+		{
+			cerr << "Motif " << k->first << " of shards is not in the motif list!" << endl;
+			return 1;
+		}
+	}
+	ofstream hScor(o.data());
+	if(!hScor)
+	{
+		cerr << "Can't open " << o << endl;
+		return 1;
+	}
+	for(size_t i = 0; i < motiflst.size(); i++)
+	{
+		map<string, string>::const_iterator k = lines.find(motiflst[i]);
+		if(k == lines.end())
+		{
+			cerr << "Motif " << motiflst[i] << " is not in any shard!" << endl;
+			return 1;
+		}
+		hScor << k->second << endl;
+	}
+	hScor.close();
+
+	return 0;
+}
+
+// Output the top motif pairs to "o.pairs", and their motifs to "o" as a score list: 
+// each motif at the score and depth of the best pair it is in, so the motifs of 
+// the top pairs are the first candidates of BBNet & GBNet.
+int outpairs(const vector<PairScore>& vps, const string& o)
+{
+	ofstream hPair((o + ".pairs").data());
+	if(!hPair)
+	{
+		cerr << "Can't open " << o << ".pairs" << endl;
+		return 1;
+	}
+	vector<MotifScore> vscor;
+	set<string> motifs;
+	for(size_t i = 0; i < vps.size(); i++)
+	{
+		const PairScore& ps = vps[i];
+		hPair << ps.name0 << "\t" << ps.name1 << "\t" << ps.score << "\t" << func_depths[ps.didx0] 
+			<< "\t" << func_depths[ps.didx1] << "\t" << ps.desc << "\t" << ps.para << endl;
+		MotifScore ms[2] = {{ps.name0, ps.score, ps.didx0}, {ps.name1, ps.score, ps.didx1}};
+		for(int k = 0; k < 2; k++)
+		{
+			if(motifs.insert(ms[k].name).second)
+				vscor.push_back(ms[k]);
+		}
+	}
+	hPair.close();
+
+	ofstream hScor(o.data());
+	if(!hScor)
+	{
+		cerr << "Can't open " << o << endl;
+		return 1;
+	}
+	outscor(hScor, vscor);
+	hScor.close();
+
+	return 0;
+}
+
+// Scores kept in the cache, keyed by the hash of the run settings and of a motif's binding.
+typedef map<pair<unsigned long long, unsigned long long>, MotifScore> ScorCache;
+
+// 64-bit FNV-1a hash of n bytes, continued from hash h.
+unsigned long long fnv1a(const char* p, size_t n, unsigned long long h = 14695981039346656037ULL)
+{
+	for(size_t i = 0; i < n; i++)
+	{
+		h ^= (unsigned char)p[i];
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+// Hash of all a presence score depends on besides the binding: both gene sets, 
+// score type, priors, network prior and the depth grid.
+unsigned long long runkey(const vector<Case>& tlst, const vector<Case>& blst)
+{
+	ostringstream k;
+	k.precision(17);
+	const vector<Case>* lsts[] = {&tlst, &blst};
+	for(int i = 0; i < 2; i++)
+	{
+		vector<string> v;
+		for(size_t j = 0; j < lsts[i]->size(); j++)
+			v.push_back((*lsts[i])[j].name);
+		sort(v.begin(), v.end());
+		for(size_t j = 0; j < v.size(); j++)
+			k << v[j] << "\n";
+		k << "\t";
+	}
+	k << itag << "\t" << prior << "\t" << pricnt << "\t" << logK << "\t";
+	for(set<string>::const_iterator i = primo.begin(); i != primo.end(); i++)
+		k << *i << "\n";
+	k << "\t";
+	for(int i = 0; i < nfunc; i++)
+		k << func_depths[i] << "\n";
+	string s = k.str();
+	return fnv1a(s.data(), s.size());
+}
+
+// Hash of the content of a motif's binding file; 0 if it can't be read.
+unsigned long long funchash(const string& motif, const string& folder)
+{
+	string fBind = folder + "/" + motif + ".func";
+	ifstream h(fBind.data(), ios::binary);
+	if(!h)
+		return 0;
+	unsigned long long k = fnv1a(NULL, 0);
+	char buf[65536];
+	while(h.read(buf, sizeof buf) || h.gcount() > 0)
+		k = fnv1a(buf, (size_t)h.gcount(), k);
+	return k;
+}
+
+// Load the cache: one score per line as run_key func_key motif score depth_index.
+// A missing file is an empty cache and malformed lines are skipped.
+void loadcache(ScorCache& cache, const string& f)
+{
+	ifstream h(f.data());
+	string strLn;
+	while(getline(h, strLn))
+	{
+		istringstream strmLn(strLn);
+		unsigned long long rk, fk;
+		MotifScore ms;
+		if(!(strmLn >> hex >> rk >> fk >> dec >> ms.name >> ms.score >> ms.didx) || ms.didx < 0 || ms.didx >= nfunc)
+			continue;
+		cache[make_pair(rk, fk)] = ms;
+	}
+}
+
+// Save the cache through a temporary file, so it is never left half written.
+int savecache(const ScorCache& cache, const string& f)
+{
+	string t = f + ".tmp";
+	ofstream h(t.data());
+	if(!h)
+		return 1;
+	h.precision(17);
+	for(ScorCache::const_iterator i = cache.begin(); i != cache.end(); i++)
+	{
+		h << hex << setfill('0') << setw(16) << i->first.first << "\t" << setw(16) << i->first.second 
+			<< dec << setfill(' ') << "\t" << i->second.name << "\t" << i->second.score << "\t" << i->second.didx << endl;
+	}
+	h.close();
+	if(!h)
+		return 1;
+	return rename(t.data(), f.data());
+}
+
+// Scores of the motifs taken from the cache file "fc" where the binding and the run 
+// settings are unchanged; the other motifs are scored and added to the cache. 
+// Return 1 if a binding file can't be read.
+int cachescor(vector<MotifScore>& vscor, const vector<string>& motiflst, const vector<Case>& genlst, 
+			  unsigned long long rk, const string& fc)
+{
+	ScorCache cache;
+	loadcache(cache, fc);
+	vector<unsigned long long> fk(motiflst.size());
+	parfor((int)motiflst.size(), [&](int i)
+	{
+		fk[i] = funchash(motiflst[i], bfolder);
+	});
+	vscor.assign(motiflst.size(), MotifScore());
+	vector<string> todo;	// motifs to be scored.
+	vector<size_t> pos;		// their positions in the list.
+	for(size_t i = 0; i < motiflst.size(); i++)
+	{
+		ScorCache::const_iterator k = cache.find(make_pair(rk, fk[i]));
+		if(fk[i] != 0 && k != cache.end())
+		{
+			vscor[i] = k->second;
+			vscor[i].name = motiflst[i];
+		}
+		else
+		{
+			todo.push_back(motiflst[i]);
+			pos.push_back(i);
+		}
+	}
+#ifdef VERBOSE
+	cout << "Motifs found in cache: " << motiflst.size() - todo.size() << "; to be scored: " << todo.size() << endl;
+#endif
+	if(todo.empty())
+		return 0;
+	vector<MotifScore> vnew;
+	if(streamscor(vnew, todo, genlst) != 0)
+		return 1;
+	for(size_t i = 0; i < todo.size(); i++)
+	{
+		vscor[pos[i]] = vnew[i];
+		cache[make_pair(rk, fk[pos[i]])] = vnew[i];
+	}
+	if(savecache(cache, fc) != 0)
+		cerr << "Can't save cache " << fc << endl;	// scores are still output.
+	return 0;
+}
 
 int main(int argc, char* argv[])
 {
 	CCmdLine cmdLine;
 
-	if(cmdLine.SplitLine(argc, argv) < 5)
+	if(cmdLine.SplitLine(argc, argv) < 5 && !cmdLine.HasSwitch("-merge"))
 	{
 		cerr << "Usage: ./bayescor -m motif_list -n node_list -b bkg_list -f func_depth_folder -o output" << endl;
+		cerr << "   or: ./bayescor -m motif_list -o output -merge shard_output1 shard_output2 ..." << endl;
 		cerr << "-i\tUse mutual information instead of Bayesian score" << endl;
+		cerr << "-j\tNumber of threads to score motifs(Default = all cores)" << endl;
+		cerr << "-shard\ti/n: score only the i-th of n equal slices of the motif list, i = 1..n" << endl;
+		cerr << "-pairs\tScore every pair of motifs by joint presence and keep the top N(Default = 50)" << endl;
+		cerr << "-po\tAlso try distance and order of each pair at the default thresholds;" << endl;
+		cerr << "\tthe binding of all motifs is kept in memory until all pairs are scored" << endl;
+		cerr << "-cache\tFile of cached scores; only motifs with new binding or settings are scored" << endl;
 		cerr << endl << "This calculate single motif's presence score on a cluster." << endl;
 		cerr << "You need to run it before BBNet & GBNet." << endl;
 		cerr << endl << "Contact: \"Li Shen\"<shen@ucsd.edu>" << endl;
@@ -33,10 +288,13 @@ int main(int argc, char* argv[])
 	try
 	{
 		m = cmdLine.GetArgument("-m", 0);
-		n = cmdLine.GetArgument("-n", 0);
-		b = cmdLine.GetArgument("-b", 0);
-		f = cmdLine.GetArgument("-f", 0);
 		o = cmdLine.GetArgument("-o", 0);
+		if(!cmdLine.HasSwitch("-merge"))
+		{
+			n = cmdLine.GetArgument("-n", 0);
+			b = cmdLine.GetArgument("-b", 0);
+			f = cmdLine.GetArgument("-f", 0);
+		}
 	}
 	catch(int)
 	{
@@ -46,6 +304,8 @@ int main(int argc, char* argv[])
 
 	if(cmdLine.HasSwitch("-i"))
 		itag = true;
+	string j = cmdLine.GetSafeArgument("-j", 0, "0");	// number of threads.
+	nthread = atoi(j.data());
 
 	//itag = true;
 	//string m = "../gbnet/data/Beer/motifs.list";
@@ -67,6 +327,30 @@ int main(int argc, char* argv[])
 		cout << "Load motif list completed!" << endl;
 #endif
 	}
+	if(cmdLine.HasSwitch("-merge"))	// Merge outputs of shards instead of scoring.
+	{
+		vector<string> shards;
+		for(int i = 0; i < cmdLine.GetArgumentCount("-merge"); i++)
+			shards.push_back(cmdLine.GetArgument("-merge", i));
+		return mergescor(motiflst, shards, o);
+	}
+	string sh = cmdLine.GetSafeArgument("-shard", 0, "");	// i/n: the i-th of n slices.
+	if(sh != "" && cmdLine.HasSwitch("-pairs"))
+	{
+		cerr << "Pairs need the whole motif list and can't be sharded!" << endl;
+		return 1;
+	}
+	if(sh != "")
+	{
+		int si = 0, sn = 0;
+		if(sscanf(sh.data(), "%d/%d", &si, &sn) != 2 || sn < 1 || si < 1 || si > sn)
+		{
+			cerr << "Shard must be i/n with 1 <= i <= n!" << endl;
+			return 1;
+		}
+		size_t n0 = motiflst.size()*(si - 1)/sn, n1 = motiflst.size()*si/sn;
+		motiflst = vector<string>(motiflst.begin() + n0, motiflst.begin() + n1);
+	}
 
 	// Load gene list.
 	vector<Case> tlst, blst;
@@ -90,59 +374,37 @@ int main(int argc, char* argv[])
 	genlst.insert(genlst.end(), tlst.begin(), tlst.end());
 	genlst.insert(genlst.end(), blst.begin(), blst.end());
 
-	// Load motif binding information.
-	if(loadbind(allbind, motiflst, genset, f) != 0)
-	{
-		cerr << "Load binding information error!" << endl;
-		return 1;
-	}
-	else
+	// Motif binding is loaded one motif at a time by each thread.
+	mkgidx(genset);
+	setgidx(genlst);
+	bfolder = f;
+	conscap = 0;	// bitmaps of a motif are not used after it is scored.
+
+	if(cmdLine.HasSwitch("-pairs"))
 	{
-#ifdef VERBOSE
-		cout << "Load binding information completed!" << endl;
-#endif
+		string np = cmdLine.GetSafeArgument("-pairs", 0, "");	// number of top pairs.
+		size_t ntop = (np != "")? (size_t)atoi(np.data()) : 50;
+		vector<PairScore> vps;
+		if(pairscor(vps, motiflst, genlst, ntop, cmdLine.HasSwitch("-po")) != 0)
+		{
+			cerr << "Load binding information error!" << endl;
+			return 1;
+		}
+		return outpairs(vps, o);
 	}
 
-	mbnd.clear();
-	mbnd.insert(0);	// Always only one motif in the list.
 	vector<MotifScore> vscor;	// Store the final results for all motifs.
 	// Calculate Bayesian score for each motif at each functional depth.
-	for(size_t i = 0; i < motiflst.size(); i++)
+	string fc = cmdLine.GetSafeArgument("-cache", 0, "");	// file of cached scores.
+	int err;
+	if(fc == "")
+		err = streamscor(vscor, motiflst, genlst);
+	else
+		err = cachescor(vscor, motiflst, genlst, runkey(tlst, blst), fc);
+	if(err != 0)
 	{
-		mscor.clear();	// Clear all motifs' score and depth to restart.
-		MotifScore scor;	// scor is used to initialize mscor and store the best.
-		scor.name = motiflst[i];
-		scor.score = 1.0;
-		mscor.push_back(scor);
-
-#ifdef VERBOSE
-		cout << "Calculating score for motif " << motiflst[i] << "..." << endl;
-#endif
-		for(int j = 0; j < nfunc; j++)
-		{
-#ifdef VERBOSE
-			cout << "Choosing functional depth " << func_depths[j] << "..." << endl;
-#endif
-			vector<CPTRow> cpt, ppt;
-
-			Constraint pres = {"pres", 0, -1, -1};
-			vector<Constraint> cons;
-			cons.push_back(pres);
-
-			mscor[0].depth = func_depths[j];
-			constrcpt(cpt, ppt, genlst, cons);
-			double s;
-			if(!itag)
-				s = score(1, cpt, ppt);
-			else
-				s = iscore(1, cpt);
-			if(scor.score == 1 || s > scor.score)
-			{
-				scor.score = s;
-				scor.depth = func_depths[j];
-			}
-		}
-		vscor.push_back(scor);
+		cerr << "Load binding information error!" << endl;
+		return 1;
 	}
 
 	// Output all motifs' scores and optimal depths.
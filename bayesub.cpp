@@ -11,25 +11,248 @@
 #include <algorithm>
 #include <utility>
 #include <math.h>
+#include <limits.h>
+#include <string.h>
+#include <charconv>
+#include <list>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <random>
+#include <chrono>
+#include <csignal>
+#include <stdio.h>
+#include <filesystem>
 #include "bayesub.h"
 #include "globals.h"
 #include "sa.h"
 #include "fisher2.h"
+#include "thrpool.h"
+
+// Guard for motif binding loaded on first use.
+static mutex bndmtx;
+static condition_variable bndcv;
+static set<string> bndload;	// motifs being loaded.
+static thread_local thread fetcher;	// background loading of the next motif.
+static list<string> bndlru;	// loaded motifs, most recently used first.
+static map<string, list<string>::iterator> bndpos;	// position of each motif in "bndlru".
+static size_t bndbytes = 0, bndpeak = 0;	// current and peak memory of binding.
+static long bndhit = 0, bndmiss = 0, bndevict = 0;	// counters of binding cache.
+static BindPtr getbind(const string& motif, bool evict);
+
+// Cache of genes satisfying each constraint.
+struct ConsKey{
+	int rule, m0, m1, para, d0, d1;	// rule, motifs, parameter and depths.
+	bool operator<(const ConsKey& k) const
+	{
+		if(rule != k.rule) return rule < k.rule;
+		if(m0 != k.m0) return m0 < k.m0;
+		if(m1 != k.m1) return m1 < k.m1;
+		if(para != k.para) return para < k.para;
+		if(d0 != k.d0) return d0 < k.d0;
+		return d1 < k.d1;
+	}
+};
+struct ConsEntry{
+	ConsBits bits;
+	list<ConsKey>::iterator pos;	// position in "conslru".
+};
+static mutex consmtx;
+static map<string, int> motids;	// number of each motif's name.
+static map<ConsKey, ConsEntry> conscache;
+static list<ConsKey> conslru;	// cached constraints, most recently used first.
+static size_t consbytes = 0;	// memory of cached bitmaps.
+static long conshit = 0, consmiss = 0;	// counters of constraint cache.
+
+// Table of CPTs of networks visited by each searching thread. The workers of a beam 
+// or tabu step share the table of the thread that runs the search.
+struct NetEntry{
+	vector<CPTRow> cpt;	// CPT with constraints in canonical order.
+	list<vector<int> >::iterator pos;	// position in "lru".
+};
+struct NetTab{
+	map<vector<int>, NetEntry> tab;
+	list<vector<int> > lru;	// visited networks, most recently used first.
+	mutex m;	// guard of the table shared by workers.
+};
+static thread_local NetTab owntab;
+static thread_local NetTab* nettab = nullptr;	// table shared by a worker, or "owntab".
+static atomic<long> nethit(0), netmiss(0);	// counters of network table of all threads.
+
+static thread_local mt19937 rng(1);	// random numbers of each searching thread.
+
+// Stream of progress messages. Messages of pool workers are dropped, as lines of 
+// concurrent jobs would interleave on the console.
+static ostream& vout()
+{
+	static thread_local ostream none(nullptr);
+	return pooljob()? none : cout;
+}
+
+// Moves rejected by a deterministic search under their canonical key, with the 
+// version of the network when they were rejected. Every accepted change of the 
+// network increases its version.
+static thread_local unsigned long netver = 0;
+static thread_local map<long long, unsigned long> rejmove;
+static atomic<long> movskip(0);	// moves skipped by all threads.
+static atomic<long> bndrule(0), bndpara(0);	// rules and parameters pruned by bound.
+static const char* rules[] = {"pres", "tss", "orien", "sec", "dist", "order", "loop"};
+static const int nrule = sizeof rules/sizeof rules[0];	// depth moves are keyed after all rules.
+static int ruleid(const string& desc);
+
+// Candidate constraints of the exact search with one rule and motifs.
+struct ExactSlot{
+	Constraint c;	// rule and motifs; parameter is set from "paras".
+	vector<int> paras;
+	vector<ConsBits> bits;	// genes satisfying the constraint at each parameter.
+	int ngene;	// genes satisfying it at any parameter.
+};
+// State of one exact search shared by its threads.
+struct ExactRun{
+	const vector<Case>* genlst;
+	vector<ExactSlot> slots;	// in canonical order; a network takes slots in this order.
+	vector<vector<unsigned long long> > rest;	// genes satisfying any constraint of slot k or later.
+	bool bound;	// prune by upper bound of score.
+	double K;	// logK of the calling thread.
+	vector<MotifScore> vms;	// motifs of the calling thread.
+	mutex m;	// guard of the best network.
+	atomic<double> best;
+	vector<Constraint> bcons;
+	vector<CPTRow> bcpt;
+	atomic<long> nodes;
+	long budget;
+	chrono::steady_clock::time_point deadline;
+	atomic<bool> stop;	// out of nodes or time.
+	bool snap;	// better networks are written to the file of setsnap.
+};
+static void exnode(ExactRun& r, vector<Constraint>& cons, const vector<int>& tidx, size_t next, bool par);
+static atomic<long> exruns(0), exstops(0), exnodes(0), exprune(0);	// counters of exact search.
+
+// One move of beam and tabu search.
+enum{MOVPRES, MOVDEPTH, MOVADD, MOVDEL};
+struct NetMove{
+	int kind;	// add presence at the best depth, change depth, add a rule or delete.
+	Constraint c;	// rule and motifs of the move; the deleted constraint for MOVDEL.
+	int pos;	// position of the deleted constraint.
+};
+static void movelist(const BSolu& n, vector<NetMove>& mv);
+static BSolu domove(const BSolu& n, const NetMove& m, const vector<Case>& genlst);
+static long long stepkey(const NetMove& m);
+static vector<int> netkey(const BSolu& n);
+static vector<int> paraset(const string& desc);
+static bool snapping();
+static void snapshot(double s, const vector<Constraint>& cons, const vector<CPTRow>& cpt, const vector<MotifScore>& ms);
+static thread_local vector<pair<double, double> > qtrace;	// seconds and best score of the last beam or tabu search.
+static atomic<long> mhprop(0), mhacc(0), mhnsec(0);	// proposals, acceptances and nanoseconds of MH kernel.
+
+// State of the adaptive annealing schedule of each searching thread.
+static thread_local bool calib = false;	// worse networks are rejected while their score deltas are collected.
+static thread_local vector<double> updelta;	// score deltas of worse networks seen while calibrating.
+static thread_local long upprop = 0, upacc = 0;	// worse networks proposed and accepted in this repeat.
+static thread_local double sabest = 1;	// best score seen by the schedule.
+static thread_local long sabestev = 0;	// networks evaluated when it was seen.
+
+// Temperature test of a network with score s0 against the current score s when 
+// jumping is allowed. Worse networks are counted for the adaptive schedule.
+static bool jumpto(double s0, double s, bool jump)
+{
+	bool a = 1/Temp*(s0-s) > log10(unirand());
+	if(!jump || s0 >= s)
+		return a && jump;
+	upprop++;
+	if(calib)
+	{
+		updelta.push_back(s - s0);
+		return false;
+	}
+	if(a)
+		upacc++;
+	return a;
+}
+
+// Temperature at which a worse network of the mean delta collected while 
+// calibrating is accepted with ratio "iniacc". Return "Temp" if none was seen.
+static double calibtemp()
+{
+	calib = false;
+	upprop = upacc = 0;
+	if(updelta.empty())
+		return Temp;
+	double m = 0;
+	for(size_t i = 0; i < updelta.size(); i++)
+		m += updelta[i]/updelta.size();
+	updelta.clear();
+	return m/-log10(iniacc);
+}
+
+// Cooling rate of the next repeat. The adaptive schedule compares the acceptance 
+// a of worse networks in this repeat with "tgtacc": above it the temperature goes 
+// down to where a worse network of the same delta is accepted with "tgtacc", i.e. 
+// by log(a)/log(tgtacc) but at least by Alpha; below it cooling slows down to 
+// Alpha^(1/2) for a repeat that accepts nothing.
+static double coolrate()
+{
+	if(!adaptsa || upprop == 0)
+		return Alpha;
+	double a = (double)upacc/upprop;
+	upprop = upacc = 0;
+	if(a < tgtacc)
+		return pow(Alpha, 0.5 + 0.5*a/tgtacc);
+	double r = (a < 0.99)? log10(a)/log10(tgtacc) : log10(0.99)/log10(tgtacc);
+	if(r < 0.1)
+		r = 0.1;
+	return (r < Alpha)? r : Alpha;
+}
+
+// Record the best score seen by the schedule. Return true if the adaptive 
+// schedule has evaluated more than "patience" networks without a better one.
+static bool sastop(double s)
+{
+	if(sabest == 1 || s > sabest)
+	{
+		sabest = s;
+		sabestev = nevals;
+	}
+	return adaptsa && patience > 0 && nevals - sabestev > patience;
+}
+
+// Canonical key of a move: rule and its motifs in order, so that symmetric 
+// pairs such as dist of a and b and dist of b and a share one key.
+static long long movekey(int rule, int m0, int m1)
+{
+	if(m1 != -1 && m1 < m0)
+		swap(m0, m1);
+	return ((long long)rule << 42) | ((long long)(m0 + 1) << 21) | (long long)(m1 + 1);
+}
+
+// Test whether a move was rejected and the network has not changed since.
+static bool unchanged(long long k)
+{
+	map<long long, unsigned long>::const_iterator i = rejmove.find(k);
+	if(i != rejmove.end() && i->second == netver)
+	{
+		movskip++;
+		return true;
+	}
+	return false;
+}
 
 // Learn Bayesian network - BBNet.
 double bbnet(vector<Constraint>& cons, vector<CPTRow>& cpt, const vector<Case>& genlst)
 {
 	double s = addpres(0, cons, cpt, 1, genlst);	// Add first motif into Bayesian network.
 #ifdef VERBOSE
-	cout << "Adding motif " << mscor[0].name << endl;
+	vout() << "Adding motif " << mscor[0].name << endl;
 #endif
-	for(size_t i = 0; i < mscor.size();)
+	for(size_t i = 0; i < mscor.size() && !timeup();)
 	{
 		// Delete constraint to improve score.
 		if(i != 0)	// This step is added to possibly delete constraints before new constraints are added.
 			s = delcons(cons, cpt, s, genlst);
-		for(set<int>::const_iterator mi = mbnd.begin(); mi != mbnd.end(); mi++)	// Try all rules for current motifs in list.
+		for(set<int>::const_iterator mi = mbnd.begin(); mi != mbnd.end() && !timeup(); mi++)	// Try all rules for current motifs in list.
 		{
+			snapshot(s, cons, cpt);	// every change of bbnet is better.
 			Constraint c;
 			// Test a new functional depth.
 			if(i != 0)
@@ -125,10 +348,11 @@ double bbnet(vector<Constraint>& cons, vector<CPTRow>& cpt, const vector<Case>&
 		{
 			s = s1;
 #ifdef VERBOSE
-			cout << "Adding motif " << mscor[(int)i].name << endl;
+			vout() << "Adding motif " << mscor[(int)i].name << endl;
 #endif
 		}
 	}
+	waitfetch();
 	return s;
 }
 
@@ -138,27 +362,36 @@ double gbnet(vector<Constraint>& cons, vector<CPTRow>& cpt, const vector<Case>&
 {
 	double s;	// Bayesian score.
 	int rep, iter;	// global iterators for repeat AND iteration.
+	bool stop = false;	// no better network within patience of the adaptive schedule.
+	calib = adaptsa;	// The first iteration is greedy and calibrates initial temperature.
+	updelta.clear();
+	upprop = upacc = 0;
+	sabest = 1;
 	s = addpres(0, cons, cpt, 1, genlst, true);	// Add first motif into Bayesian network.
 #ifdef VERBOSE
-	cout << "Adding motif " << mscor[0].name << endl;
+	vout() << "Adding motif " << mscor[0].name << endl;
 #endif
-	for(rep = 0; rep < Repeat; rep++)	// repeat level.
+	for(rep = 0; rep < Repeat && !stop; rep++)	// repeat level.
 	{
-		cout << "**** Running Bayesian network at temperature: " << Temp << " ****" << endl;
+		vout() << "**** Running Bayesian network at temperature: " << Temp << " ****" << endl;
 		for(iter = 0; iter < Iteration; iter++)	// iteration level.
 		{
-			if(!chkcons(cons, "pres", 0))
+			for(int k = 0; k < mhiter && mhkern; k++)	// Random moves instead of trying all.
+				s = mhstep(cons, cpt, s, genlst);
+			if(mhkern)
+				stop = sastop(s) || timeup();
+			if(!mhkern && !chkcons(cons, "pres", 0))
 			{
 				double s1 = addpres(0, cons, cpt, s, genlst, true);	// Add first motif into Bayesian network.
 				if(s1 != s)
 				{
 #ifdef VERBOSE
-					cout << "Adding motif " << mscor[0].name << endl;
+					vout() << "Adding motif " << mscor[0].name << endl;
 #endif
 					s = s1;
 				}
 			}
-			for(size_t i = 0; i < mscor.size();)
+			for(size_t i = 0; i < mscor.size() && !mhkern && !stop;)
 			{
 				// Delete constraint to improve score before considering new constraints.
 				// s = delcons(cons, cpt, s, genlst, mbnd);
@@ -245,6 +478,7 @@ double gbnet(vector<Constraint>& cons, vector<CPTRow>& cpt, const vector<Case>&
 				}
 				// Delete constraint to improve score.
 				s = delcons(cons, cpt, s, genlst);
+				stop = sastop(s) || timeup();
 				// Add constraint: another new motif. If no improvement, break the loop.
 				double s1 = s;
 				for(;i < mscor.size()-1 && s1 == s; i++)
@@ -258,19 +492,32 @@ double gbnet(vector<Constraint>& cons, vector<CPTRow>& cpt, const vector<Case>&
 				{
 					s = s1;
 #ifdef VERBOSE
-					cout << "Adding motif " << mscor[(int)i].name << endl;	// "i" now refer to the new added motif.
+					vout() << "Adding motif " << mscor[(int)i].name << endl;	// "i" now refer to the new added motif.
 #endif
 				}
 			}	// Iteration.
+			if(calib)
+			{
+				Temp = calitemp = calibtemp();
+				vout() << "Initial temperature calibrated to: " << Temp << endl;
+			}
+			if(stop)
+				break;
 			if(Restag)
 				s = restart(s, cons, cpt, iter);
 			if(chng > Changes || rests > Restarts)	// Required changes have been made. Go to next repeat.
 				break;				// OR, restarting reaches maximum number.
 		}	// Repeat.
 		// Summarize information about this repeat.
-		cout << chng << " changes have been made at temperature: " << Temp << endl;
-		cout << "After " << iter << " iterations." << endl;
-		cout << "And " << rests << " restarts." << endl;
+		vout() << chng << " changes have been made at temperature: " << Temp << endl;
+		vout() << "After " << iter << " iterations." << endl;
+		vout() << "And " << rests << " restarts." << endl;
+		if(adaptsa && upprop > 0)
+			vout() << "Worse networks accepted: " << upacc << " of " << upprop << endl;
+		if(timeup())
+			vout() << "Search stopped at the time limit." << endl;
+		else if(stop)
+			vout() << "No better network in " << patience << " evaluations." << endl;
 
 		if(chng < Resthrld && iter == Iteration)	// Temperature is cool now.
 			Restag = true;	// Set tag to restart SA if bad condition happens.
@@ -278,27 +525,327 @@ double gbnet(vector<Constraint>& cons, vector<CPTRow>& cpt, const vector<Case>&
 			break;
 		chng = 0;	// Reset counter for changes.
 		rests = 0;	// Reset counter for restartings.
-		Temp *= Alpha;	// Decrease temperature by rate alpha.
+		if(isldir != "" && (rep + 1) % islgap == 0)	// Exchange best networks with other islands.
+			s = migrate(s, cons, cpt, genlst);
+		Temp *= coolrate();	// Decrease temperature by rate alpha.
 	}	// Whole procedure.
+	if((mhkern || adaptsa || timeup()) && tagbests && bsolu.s != 1 && bsolu.s > s)	// a random walk may end below its best network.
+	{
+		s = bsolu.s;
+		cons = bsolu.cons;
+		cpt = bsolu.cpt;
+		mbnd = bsolu.mbnd;
+		mscor = bsolu.mscor;
+	}
+	if(isldir != "" && bsolu.s != 1 && savenet(isldir + "/" + islname, bsolu) != 0)	// final network for the merge.
+		cerr << "Can't write " << isldir + "/" + islname << endl;
+	waitfetch();
 
 	return s;
 }
+
+
+// Learn Bayesian network - exact search.
+// Constraint sets of up to "maxpa" constraints on the candidate motifs at their 
+// functional depths are enumerated in canonical order by branch and bound. The 
+// network of bbnet is the first incumbent and subtrees of the first constraint 
+// are expanded in parallel. If "exbudget" nodes or "exsecs" seconds run out, the 
+// best network found so far is returned.
+double bbexact(vector<Constraint>& cons, vector<CPTRow>& cpt, const vector<Case>& genlst)
+{
+	vector<MotifScore> vms = mscor;
+	double s = bbnet(cons, cpt, genlst);	// incumbent.
+	set<int> gbnd = mbnd;
+	vector<MotifScore> gscor = mscor;
+
+	ExactRun r;
+	r.genlst = &genlst;
+	r.bound = (prior == 0 && !itag);
+	r.K = logK;
+	r.vms = vms;
+	r.best = s;
+	r.nodes = 0;
+	r.budget = exbudget;
+	r.deadline = chrono::steady_clock::now() + chrono::milliseconds((long long)(exsecs*1000));
+	r.stop = false;
+	r.snap = snapping();
+	for(int i = 0; i < (int)vms.size(); i++)
+	{
+		ExactSlot e;
+		e.c.motif0 = i;
+		e.c.motif1 = -1;
+		e.c.desc = "pres";
+		e.paras.assign(1, -1);
+		r.slots.push_back(e);
+		if(rb[0] == '1')
+		{
+			e.c.desc = "tss";
+			e.paras.assign(tss_thrds, tss_thrds + ntsst);
+			r.slots.push_back(e);
+		}
+		if(rb[1] == '1')
+		{
+			e.c.desc = "orien";
+			e.paras.assign(1, 0);
+			e.paras.push_back(1);
+			r.slots.push_back(e);
+		}
+		if(rb[2] == '1')
+		{
+			e.c.desc = "sec";
+			e.paras.assign(1, -1);
+			r.slots.push_back(e);
+		}
+		for(int j = i + 1; j < (int)vms.size(); j++)	// pair rules are symmetric in the motifs.
+		{
+			e.c.motif1 = j;
+			if(rb[3] == '1')
+			{
+				e.c.desc = "dist";
+				e.paras.assign(dist_thrds, dist_thrds + ndistt);
+				r.slots.push_back(e);
+			}
+			if(rb[4] == '1')
+			{
+				e.c.desc = "order";
+				e.paras.assign(1, 0);
+				e.paras.push_back(1);
+				r.slots.push_back(e);
+			}
+			if(rb[5] == '1')
+			{
+				e.c.desc = "loop";
+				e.paras.assign(loop_thrds, loop_thrds + nloopt);
+				r.slots.push_back(e);
+			}
+			e.c.motif1 = -1;
+		}
+	}
+	mscor = vms;
+	r.rest.assign(r.slots.size() + 1, vector<unsigned long long>((gnames.size() + 63)/64, 0));
+	for(size_t k = 0; k < r.slots.size(); k++)
+	{
+		ExactSlot& e = r.slots[k];
+		for(size_t p = 0; p < e.paras.size(); p++)
+		{
+			e.c.para = e.paras[p];
+			e.bits.push_back(consbits(e.c));
+		}
+		vector<unsigned long long> u(r.rest[0].size(), 0);
+		for(size_t p = 0; p < e.bits.size(); p++)
+		{
+			for(size_t w = 0; w < u.size(); w++)
+				u[w] |= (*e.bits[p])[w];
+		}
+		e.ngene = 0;
+		for(size_t w = 0; w < u.size(); w++)
+			e.ngene += __builtin_popcountll(u[w]);
+	}
+	// Slots satisfied by more genes go first, so that the genes no later 
+	// constraint can separate grow quickly and tighten the bound.
+	stable_sort(r.slots.begin(), r.slots.end(), [](const ExactSlot& a, const ExactSlot& b) { return a.ngene > b.ngene; });
+	for(size_t k = r.slots.size(); k-- > 0;)
+	{
+		r.rest[k] = r.rest[k + 1];
+		for(size_t p = 0; p < r.slots[k].bits.size(); p++)
+		{
+			const vector<unsigned long long>& b = *r.slots[k].bits[p];
+			for(size_t w = 0; w < b.size(); w++)
+				r.rest[k][w] |= b[w];
+		}
+	}
+
+	vector<Constraint> root;
+	exnode(r, root, vector<int>(genlst.size(), 0), 0, true);
+	exruns++;
+	exnodes += r.nodes;
+	if(r.stop)
+		exstops++;
+#ifdef VERBOSE
+	vout() << "Exact search visited " << r.nodes << " networks" << (r.stop? ", out of budget." : ".") << endl;
+#endif
+	if(r.bcons.empty())	// no network better than bbnet's.
+	{
+		mbnd = gbnd;
+		mscor = gscor;
+		return s;
+	}
+	cons = r.bcons;
+	cpt = r.bcpt;
+	mscor = vms;
+	mbnd.clear();
+	for(size_t i = 0; i < cons.size(); i++)
+	{
+		mbnd.insert(cons[i].motif0);
+		if(cons[i].motif1 != -1)
+			mbnd.insert(cons[i].motif1);
+	}
+	return r.best;
+}
+
+// Learn Bayesian network - beam search.
+// The "beamw" best distinct networks of each step are kept and every move of 
+// each of them is tried in parallel. The search stops when no network of a step 
+// beats the best so far.
+double bmnet(vector<Constraint>& cons, vector<CPTRow>& cpt, const vector<Case>& genlst)
+{
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	BSolu best;
+	best.s = addpres(0, best.cons, best.cpt, 1, genlst);	// Add first motif into Bayesian network.
+	best.mbnd = mbnd;
+	best.mscor = mscor;
+	qtrace.assign(1, make_pair(chrono::duration<double>(chrono::steady_clock::now() - t0).count(), best.s));
+	vector<BSolu> beam(1, best);
+	RunConf conf = getconf();	// workers run with the settings of this thread.
+	NetTab* memo = &owntab;	// and with its table of networks.
+	bool tosnap = snapping();	// better networks are written to the file of setsnap.
+	if(tosnap)
+		snapshot(best.s, best.cons, best.cpt, best.mscor);
+	while(!timeup())
+	{
+		vector<pair<int, NetMove> > mv;	// network of the beam and its move.
+		for(size_t b = 0; b < beam.size(); b++)
+		{
+			vector<NetMove> v;
+			movelist(beam[b], v);
+			for(size_t i = 0; i < v.size(); i++)
+				mv.push_back(make_pair((int)b, v[i]));
+		}
+		vector<BSolu> kids(mv.size());
+		parfor((int)mv.size(), [&](int i)
+		{
+			setconf(conf);
+			nettab = memo;
+			kids[i] = domove(beam[mv[i].first], mv[i].second, genlst);
+		});
+		vector<int> ord;
+		for(size_t i = 0; i < kids.size(); i++)
+		{
+			if(kids[i].s != 1)
+				ord.push_back((int)i);
+		}
+		stable_sort(ord.begin(), ord.end(), [&kids](int a, int b) { return kids[a].s > kids[b].s; });
+		vector<BSolu> next;
+		set<vector<int> > seen;
+		for(size_t i = 0; i < ord.size() && (int)next.size() < beamw; i++)
+		{
+			if(seen.insert(netkey(kids[ord[i]])).second)
+				next.push_back(kids[ord[i]]);
+		}
+#ifdef VERBOSE
+		vout() << "Beam of " << next.size() << " networks from " << mv.size() << " moves, best " 
+			<< (next.empty()? best.s : next[0].s) << "(" << best.s << ")" << endl;
+#endif
+		if(next.empty() || next[0].s <= best.s)
+			break;
+		best = next[0];
+		if(tosnap)
+			snapshot(best.s, best.cons, best.cpt, best.mscor);
+		qtrace.push_back(make_pair(chrono::duration<double>(chrono::steady_clock::now() - t0).count(), best.s));
+		beam = next;
+	}
+	waitfetch();
+	cons = best.cons;
+	cpt = best.cpt;
+	mbnd = best.mbnd;
+	mscor = best.mscor;
+	return best.s;
+}
+
+// Learn Bayesian network - tabu search.
+// The best move is taken at each step even if the score goes down, except that 
+// reversing one of the last "tabutn" moves is tabu unless it beats the best 
+// network. The search stops after "tabustep" steps without a better network.
+double tbnet(vector<Constraint>& cons, vector<CPTRow>& cpt, const vector<Case>& genlst)
+{
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	BSolu cur;
+	cur.s = addpres(0, cur.cons, cur.cpt, 1, genlst);	// Add first motif into Bayesian network.
+	cur.mbnd = mbnd;
+	cur.mscor = mscor;
+	BSolu best = cur;
+	qtrace.assign(1, make_pair(chrono::duration<double>(chrono::steady_clock::now() - t0).count(), best.s));
+	map<long long, int> tabu;	// reversed moves and the step until which they are tabu.
+	RunConf conf = getconf();
+	NetTab* memo = &owntab;
+	bool tosnap = snapping();	// better networks are written to the file of setsnap.
+	if(tosnap)
+		snapshot(best.s, best.cons, best.cpt, best.mscor);
+	for(int step = 0, idle = 0; idle < tabustep && !timeup(); step++, idle++)
+	{
+		vector<NetMove> mv;
+		movelist(cur, mv);
+		vector<BSolu> kids(mv.size());
+		parfor((int)mv.size(), [&](int i)
+		{
+			setconf(conf);
+			nettab = memo;
+			kids[i] = domove(cur, mv[i], genlst);
+		});
+		int k = -1;
+		for(size_t i = 0; i < kids.size(); i++)
+		{
+			if(kids[i].s == 1)
+				continue;
+			map<long long, int>::const_iterator t = tabu.find(stepkey(mv[i]));
+			if(t != tabu.end() && t->second >= step && kids[i].s <= best.s)
+				continue;
+			if(k < 0 || kids[i].s > kids[k].s)
+				k = (int)i;
+		}
+		if(k < 0)	// every move is tabu.
+			break;
+		long long mk = stepkey(mv[k]);
+		tabu[(mv[k].kind == MOVDEPTH)? mk : ~mk] = step + tabutn;
+		cur = kids[k];
+#ifdef VERBOSE
+		vout() << "Tabu step " << step << ": " << mv[k].c.desc << " of " << cur.mscor[mv[k].c.motif0].name 
+			<< " ..." << cur.s << "(" << best.s << ")" << endl;
+#endif
+		if(cur.s > best.s)
+		{
+			best = cur;
+			idle = -1;
+			if(tosnap)
+				snapshot(best.s, best.cons, best.cpt, best.mscor);
+			qtrace.push_back(make_pair(chrono::duration<double>(chrono::steady_clock::now() - t0).count(), best.s));
+		}
+	}
+	waitfetch();
+	cons = best.cons;
+	cpt = best.cpt;
+	mbnd = best.mbnd;
+	mscor = best.mscor;
+	return best.s;
+}
 // *************** Main Routines End Here ******************* //
 
 
 // Take a bootstrap sample for a vector of objects.
+// Node and bkg are resampled separately; a case drawn several times is kept
+// once with its multiplicity as weight, and cases never drawn are left out.
 vector<Case> bsamp(const vector<Case>& t, const vector<Case>& b)
 {
+	vector<int> nt(t.size(), 0), nb(b.size(), 0);	// times each case is drawn.
+	for(size_t i = 0; i < t.size(); i++)
+		nt[(size_t)(unirand()*t.size())]++;
+	for(size_t i = 0; i < b.size(); i++)
+		nb[(size_t)(unirand()*b.size())]++;
+
 	vector<Case> s;
 	for(size_t i = 0; i < t.size(); i++)
 	{
-		int index = (int)floor(((double)rand()-1)/RAND_MAX*t.size());
-		s.push_back(t[index]);
+		if(nt[i] == 0)
+			continue;
+		s.push_back(t[i]);
+		s.back().wt = nt[i]*t[i].wt;
 	}
 	for(size_t i = 0; i < b.size(); i++)
 	{
-		int index = (int)floor(((double)rand()-1)/RAND_MAX*b.size());
-		s.push_back(b[index]);
+		if(nb[i] == 0)
+			continue;
+		s.push_back(b[i]);
+		s.back().wt = nb[i]*b[i].wt;
 	}
 
 	return s;
@@ -316,15 +863,458 @@ int calcnum(const vector<Case>& v, int c)
 	return n;
 }
 
+// Settings of the calling thread.
+RunConf getconf()
+{
+	RunConf c;
+	c.logK = logK;
+	c.rb = rb;
+	c.Repeat = Repeat;
+	c.Iteration = Iteration;
+	c.Changes = Changes;
+	c.Alpha = Alpha;
+	c.Initemp = Initemp;
+	c.DeterScor = DeterScor;
+	c.tagbests = tagbests;
+	return c;
+}
+
+// Apply settings to the calling thread, such as a worker of parfor.
+void setconf(const RunConf& c)
+{
+	logK = c.logK;
+	rb = c.rb;
+	Repeat = c.Repeat;
+	Iteration = c.Iteration;
+	Changes = c.Changes;
+	Alpha = c.Alpha;
+	Initemp = c.Initemp;
+	DeterScor = c.DeterScor;
+	tagbests = c.tagbests;
+}
+
+// Seed random numbers of the calling thread.
+void setseed(unsigned int seed)
+{
+	rng.seed(seed);
+}
+
+// Uniform random number in [0, 1) from the calling thread's generator.
+double unirand()
+{
+	return rng()/4294967296.0;
+}
+
+// Reset search state of the calling thread before learning a network.
+void initrun(const vector<MotifScore>& vms)
+{
+	mscor = vms;
+	mbnd.clear();
+	Temp = Initemp;
+	chng = 0;
+	rests = 0;
+	Restag = false;
+	nevals = 0;
+	calitemp = 0;
+	bsolu.s = 1.0;
+	bsolu.cons.clear();
+	bsolu.cpt.clear();
+	bsolu.mbnd.clear();
+	bsolu.mscor.clear();
+	owntab.tab.clear();
+	owntab.lru.clear();
+	rejmove.clear();
+}
+
 // Find the index in depth array according to the depth.
+// Depths off the grid are mapped to the nearest one.
 int depidx(double depth)
 {
-	for(int i = 0; i < nfunc; i++)
+	int idx = 0;
+	for(int i = 1; i < nfunc; i++)
 	{
-		if(func_depths[i] - depth < 1e-8 && func_depths[i] - depth > -1e-8)
-			return i;
+		if(fabs(func_depths[i] - depth) < fabs(func_depths[idx] - depth))
+			idx = i;
 	}
-	return -1;
+	return idx;
+}
+
+// Number of functional depths that are not above a matrix score.
+int depbin(double score)
+{
+	int b = 0;
+	while(b < nfunc && score >= func_depths[b])
+		b++;
+	return b;
+}
+
+// Bayesian score of one CPT cell without prior counts.
+static double cellscor(int k0, int k1)
+{
+	return -logamma(2 + k0 + k1) + logamma(1 + k0) + logamma(1 + k1);
+}
+
+// Upper bound of the score of a cell split by one more constraint that at most 
+// n0 of its genes in category 0 and n1 in category 1 satisfy. log Beta is jointly 
+// convex, so the best split lies at a corner of the feasible counts.
+static double splitbound(int k0, int k1, int n0, int n1)
+{
+	int a0 = min(k0, n0), a1 = min(k1, n1);
+	double b = cellscor(k0, k1);
+	b = max(b, cellscor(a0, 0) + cellscor(k0 - a0, k1));
+	b = max(b, cellscor(0, a1) + cellscor(k0, k1 - a1));
+	b = max(b, cellscor(a0, a1) + cellscor(k0 - a0, k1 - a1));
+	return b;
+}
+
+// Upper bound of the score of a network with np constraints made by adding one 
+// to the network of CPT "cpt".
+static double netbound(const vector<CPTRow>& cpt, int np, int n0, int n1)
+{
+	double b = -np*logK;
+	for(size_t i = 0; i < cpt.size(); i++)
+		b += splitbound(cpt[i].k0, cpt[i].k1, n0, n1);
+	return b;
+}
+
+// Bitmaps of indexed genes in category 1 and 0. Return false if a gene is 
+// weighted or listed twice, for which counting bits is not exact.
+static bool labmask(const vector<Case>& genlst, vector<unsigned long long>& pmask, vector<unsigned long long>& nmask)
+{
+	pmask.assign((gnames.size() + 63)/64, 0);
+	nmask.assign(pmask.size(), 0);
+	for(size_t j = 0; j < genlst.size(); j++)
+	{
+		int g = genlst[j].gi;
+		if(g < 0)	// never satisfies a constraint.
+			continue;
+		unsigned long long b = 1ULL << (g & 63);
+		if(genlst[j].wt != 1 || ((pmask[g >> 6] | nmask[g >> 6]) & b))
+			return false;
+		if(genlst[j].label == 1)
+			pmask[g >> 6] |= b;
+		else if(genlst[j].label == 0)
+			nmask[g >> 6] |= b;
+	}
+	return true;
+}
+
+// Upper bound of the score of a cell whose genes may be split by more constraints, 
+// where z0 and z1 of its genes satisfy none of them and stay together. The other 
+// genes are best split by category; log Beta is jointly convex, so the best share 
+// of them that joins the "z" genes is at a corner.
+static double zbound(int k0, int k1, int z0, int z1)
+{
+	int r0 = k0 - z0, r1 = k1 - z1;
+	double b = cellscor(k0, k1);
+	for(int a0 = 0; a0 <= r0; a0 += (r0 > 0)? r0 : 1)
+	{
+		for(int a1 = 0; a1 <= r1; a1 += (r1 > 0)? r1 : 1)
+		{
+			int x0 = r0 - a0, x1 = r1 - a1;
+			double v = max(cellscor(x0, x1), cellscor(x0, 0) + cellscor(0, x1));
+			b = max(b, cellscor(z0 + a0, z1 + a1) + v);
+		}
+	}
+	return b;
+}
+
+// Visit one network of the exact search and the networks made by adding 
+// constraints of slot "next" or later. "tidx" is the CPT entry of each gene. 
+// Children are expanded on the thread pool if "par" is set.
+static void exnode(ExactRun& r, vector<Constraint>& cons, const vector<int>& tidx, size_t next, bool par)
+{
+	long n = ++r.nodes;
+	if(n > r.budget || ((n & 4095) == 0 && (chrono::steady_clock::now() > r.deadline || timeup())))
+		r.stop = true;
+	if(r.stop)
+		return;
+	const vector<Case>& genlst = *r.genlst;
+	int np = (int)cons.size();
+	const vector<unsigned long long>& rest = r.rest[next];
+	vector<CPTRow> cpt, zpt;	// all genes and genes satisfying no later constraint.
+	initcpt(cpt, (size_t)1 << np);
+	initcpt(zpt, cpt.size());
+	for(size_t j = 0; j < genlst.size(); j++)
+	{
+		int g = genlst[j].gi, t = tidx[j];
+		bool z = (g < 0 || !(rest[g >> 6] >> (g & 63) & 1));
+		if(genlst[j].label == 0)
+		{
+			cpt[t].k0 += genlst[j].wt;
+			if(z)
+				zpt[t].k0 += genlst[j].wt;
+		}
+		else if(genlst[j].label == 1)
+		{
+			cpt[t].k1 += genlst[j].wt;
+			if(z)
+				zpt[t].k1 += genlst[j].wt;
+		}
+	}
+	if(np > 0)
+	{
+		vector<CPTRow> ppt;
+		setprior(ppt, cons);
+		double s = itag? iscore(np, cpt) : score(np, cpt, ppt);
+		if(s > r.best)
+		{
+			lock_guard<mutex> lk(r.m);
+			if(s > r.best)
+			{
+				r.best = s;
+				r.bcons = cons;
+				r.bcpt = cpt;
+				if(r.snap)
+					snapshot(s, cons, cpt, r.vms);
+			}
+		}
+	}
+	if(np >= maxpa || next >= r.slots.size())
+		return;
+	if(r.bound)
+	{
+		double b = -(np + 1)*logK;
+		for(size_t t = 0; t < cpt.size(); t++)
+			b += zbound(cpt[t].k0, cpt[t].k1, zpt[t].k0, zpt[t].k1);
+		if(b < r.best - 1e-9)
+		{
+			exprune++;
+			return;
+		}
+	}
+
+	vector<pair<size_t, size_t> > kids;	// slot and parameter of each child.
+	for(size_t k = next; k < r.slots.size(); k++)
+	{
+		for(size_t p = 0; p < r.slots[k].paras.size(); p++)
+			kids.push_back(make_pair(k, p));
+	}
+	// Add the constraint of one child and visit it.
+	auto visit = [&r, &genlst, &tidx, &kids, np](vector<Constraint>& v, int i)
+	{
+		const ExactSlot& e = r.slots[kids[i].first];
+		const vector<unsigned long long>& bits = *e.bits[kids[i].second];
+		Constraint c = e.c;
+		c.para = e.paras[kids[i].second];
+		vector<int> ct(tidx);
+		for(size_t j = 0; j < genlst.size(); j++)
+		{
+			int g = genlst[j].gi;
+			if(g >= 0 && (bits[g >> 6] >> (g & 63) & 1))
+				ct[j] |= 1 << np;
+		}
+		v.push_back(c);
+		exnode(r, v, ct, kids[i].first + 1, false);
+		v.pop_back();
+	};
+	if(par)
+	{
+		parfor((int)kids.size(), [&r, &cons, &visit](int i)
+		{
+			logK = r.K;	// settings and motifs of the calling thread.
+			mscor = r.vms;
+			vector<Constraint> v(cons);
+			visit(v, i);
+		});
+	}
+	else
+	{
+		for(size_t i = 0; i < kids.size() && !r.stop; i++)
+			visit(cons, (int)i);
+	}
+}
+
+// Parameters of a rule.
+static vector<int> paraset(const string& desc)
+{
+	vector<int> ps;
+	if(desc == "tss")
+		ps.assign(tss_thrds, tss_thrds + ntsst);
+	else if(desc == "orien" || desc == "order")
+	{
+		ps.push_back(0);
+		ps.push_back(1);
+	}
+	else if(desc == "dist")
+		ps.assign(dist_thrds, dist_thrds + ndistt);
+	else if(desc == "loop")
+		ps.assign(loop_thrds, loop_thrds + nloopt);
+	else	// pres and sec.
+		ps.push_back(-1);
+	return ps;
+}
+
+// Constraints that can be added to a network with motifs "mb", without parameter: 
+// presence of any motif, other rules of rb on the motifs of the network.
+static void addable(const vector<Constraint>& cons, const set<int>& mb, vector<Constraint>& va)
+{
+	if((int)cons.size() >= maxpa)
+		return;
+	Constraint c = {"pres", -1, -1, -1};
+	for(int i = 0; i < (int)mscor.size(); i++)
+	{
+		c.motif0 = i;
+		if(!chkcons(cons, "pres", i))
+			va.push_back(c);
+	}
+	for(set<int>::const_iterator mi = mb.begin(); mi != mb.end(); mi++)
+	{
+		c.motif0 = *mi;
+		for(int r = 1; r < nrule; r++)
+		{
+			if(rb[r - 1] != '1')
+				continue;
+			c.desc = rules[r];
+			if(r < 4)	// rules of one motif.
+			{
+				c.motif1 = -1;
+				if(!chkcons(cons, rules[r], *mi, -1))
+					va.push_back(c);
+				continue;
+			}
+			for(set<int>::const_iterator mj = mi; ++mj != mb.end();)	// pair rules are symmetric.
+			{
+				c.motif1 = *mj;
+				if(!chkcons(cons, rules[r], *mi, *mj))
+					va.push_back(c);
+			}
+		}
+		c.motif1 = -1;
+	}
+}
+
+// Moves of beam and tabu search on a network: presence of every motif not yet 
+// in it, depth of each motif in it, each rule of rb on those motifs and deletion 
+// of each constraint.
+static void movelist(const BSolu& n, vector<NetMove>& mv)
+{
+	bool full = ((int)n.cons.size() >= maxpa);
+	NetMove m;
+	m.pos = -1;
+	m.c.para = -1;
+	for(int i = 0; i < (int)n.mscor.size() && !full; i++)
+	{
+		if(chkcons(n.cons, "pres", i))
+			continue;
+		m.kind = MOVPRES;
+		m.c.desc = "pres";
+		m.c.motif0 = i;
+		m.c.motif1 = -1;
+		mv.push_back(m);
+	}
+	for(set<int>::const_iterator mi = n.mbnd.begin(); mi != n.mbnd.end(); mi++)
+	{
+		m.kind = MOVDEPTH;
+		m.c.desc = "depth";
+		m.c.motif0 = *mi;
+		m.c.motif1 = -1;
+		mv.push_back(m);
+		if(full)
+			continue;
+		m.kind = MOVADD;
+		for(int r = 1; r < nrule; r++)
+		{
+			if(rb[r - 1] != '1')
+				continue;
+			m.c.desc = rules[r];
+			if(r < 4)	// rules of one motif.
+			{
+				if(!chkcons(n.cons, rules[r], *mi, -1))
+					mv.push_back(m);
+				continue;
+			}
+			for(set<int>::const_iterator mj = mi; ++mj != n.mbnd.end();)	// pair rules are symmetric.
+			{
+				m.c.motif1 = *mj;
+				if(!chkcons(n.cons, rules[r], *mi, *mj))
+					mv.push_back(m);
+			}
+			m.c.motif1 = -1;
+		}
+	}
+	for(size_t i = 0; i < n.cons.size() && n.cons.size() > 1; i++)	// keep at least one constraint.
+	{
+		m.kind = MOVDEL;
+		m.c = n.cons[i];
+		m.pos = (int)i;
+		mv.push_back(m);
+	}
+}
+
+// Apply one move to a network and return the result with the best parameter 
+// and depth of the move, even if it scores lower. Score is 1 if the move can't be made.
+static BSolu domove(const BSolu& n, const NetMove& m, const vector<Case>& genlst)
+{
+	const double force = -HUGE_VAL;	// every network beats it, so the best of a move is taken.
+	mscor = n.mscor;
+	mbnd = n.mbnd;
+	netver++;	// moves rejected on another network don't apply.
+	BSolu r;
+	r.cons = n.cons;
+	r.cpt = n.cpt;
+	r.s = 1;
+	double s = force;
+	if(m.kind == MOVPRES)
+		s = addpres(m.c.motif0, r.cons, r.cpt, force, genlst);
+	else if(m.kind == MOVDEPTH)
+		s = updepth(m.c.motif0, r.cons, r.cpt, force, genlst);
+	else if(m.kind == MOVADD)
+	{
+		vector<int> ps = paraset(m.c.desc);
+		s = addcons(r.cons, r.cpt, m.c, force, genlst, &ps[0], (int)ps.size());
+	}
+	else
+	{
+		r.cons.erase(r.cons.begin() + m.pos);
+		s = evalnet(r.cpt, genlst, r.cons);
+		for(set<int>::iterator mi = mbnd.begin(); mi != mbnd.end();)	// motifs no longer in the network.
+		{
+			bool tag = false;
+			for(size_t j = 0; j < r.cons.size() && !tag; j++)
+				tag = (*mi == r.cons[j].motif0 || *mi == r.cons[j].motif1);
+			if(tag)
+				mi++;
+			else
+				mbnd.erase(mi++);
+		}
+	}
+	if(s == force || s == 1)
+		return r;
+	r.s = s;
+	r.mbnd = mbnd;
+	r.mscor = mscor;
+	return r;
+}
+
+// Key of a move by its rule and motifs as "movekey"; deletions are complemented.
+static long long stepkey(const NetMove& m)
+{
+	if(m.kind == MOVDEPTH)
+		return movekey(nrule, m.c.motif0, -1);
+	long long k = movekey(ruleid(m.c.desc), m.c.motif0, m.c.motif1);
+	return (m.kind == MOVDEL)? ~k : k;
+}
+
+// Rule, motifs, depths and parameter of each constraint of a network in canonical order.
+static vector<int> netkey(const BSolu& n)
+{
+	vector<vector<int> > vk(n.cons.size());
+	for(size_t i = 0; i < n.cons.size(); i++)
+	{
+		const Constraint& c = n.cons[i];
+		vk[i].push_back(ruleid(c.desc));
+		vk[i].push_back(c.motif0);
+		vk[i].push_back(n.mscor[c.motif0].didx);
+		vk[i].push_back(c.motif1);
+		vk[i].push_back((c.motif1 == -1)? -1 : n.mscor[c.motif1].didx);
+		vk[i].push_back(c.para);
+	}
+	sort(vk.begin(), vk.end());
+	vector<int> key;
+	for(size_t i = 0; i < vk.size(); i++)
+		key.insert(key.end(), vk[i].begin(), vk[i].end());
+	return key;
 }
 
 // Add a presence node into Bayesian network.
@@ -335,10 +1325,15 @@ double addpres(int mi, vector<Constraint>& cons, vector<CPTRow>& cpt, double s,
 	c.motif0 = mi;
 	c.motif1 = -1;
 	c.para = -1;
+	long long mk = movekey(ruleid("pres"), mi, -1);
+	if(!jump && s != 1 && unchanged(mk))
+		return s;
 
 	string motif = mscor[mi].name;
+	if(fetchtag && mi + 1 < (int)mscor.size())	// load the next candidate while this one is tried.
+		prefetch(mscor[mi+1].name);
 #ifdef VERBOSE
-	cout << "Considering constraint: pres of " << motif;
+	vout() << "Considering constraint: pres of " << motif;
 #endif
 	int didx = -1;	// Depth index of original binding, if exist.
 	bool tag = false;	// tag to test whether this motif's binding is in stack.
@@ -348,7 +1343,7 @@ double addpres(int mi, vector<Constraint>& cons, vector<CPTRow>& cpt, double s,
 		mbnd.insert(mi);
 	}
 	else
-		didx = depidx(mscor[mi].depth);
+		didx = mscor[mi].didx;
 
 	double s0 = 1.0;	// Best Bayesian score.
 	vector<Constraint> cons0;	// Best Constraints.
@@ -358,7 +1353,7 @@ double addpres(int mi, vector<Constraint>& cons, vector<CPTRow>& cpt, double s,
 	{
 		vector<Constraint> cons1 = cons;
 		vector<CPTRow> cpt1 = cpt;
-		mscor[mi].depth = func_depths[i];
+		mscor[mi].didx = i;
 		int pres[] = {-1};
 		double s1 = addcons(cons1, cpt1, c, s0, genlst, pres, 1, false);	// Add presence without jumping.
 		if(s1 > s0 || s0 == 1)
@@ -370,25 +1365,31 @@ double addpres(int mi, vector<Constraint>& cons, vector<CPTRow>& cpt, double s,
 		}
 	}
 #ifdef VERBOSE
-	cout << " ..." << s0 << "(" << s << ")" << endl;
+	vout() << " ..." << s0 << "(" << s << ")" << endl;
 #endif
-	if(s == 1 || s0 > s || (1/Temp*(s0-s) > log10((double)rand()/RAND_MAX) && jump))	// Use temperature to control jumping.
+	if(s == 1 || s0 > s || jumpto(s0, s, jump))	// Use temperature to control jumping.
 	{
 #ifdef VERBOSE
-		cout << "Accepting constraint: pres of " << motif << endl;
+		vout() << "Accepting constraint: pres of " << motif << endl;
 #endif
 		chng++;	// Increase counter if accept presence.
+		netver++;
 		s = s0;
 		cons = cons0;
 		cpt = cpt0;
-		mscor[mi].depth = func_depths[didx0];
+		mscor[mi].didx = didx0;
 		if(tagbests)
 			bestsolu(s, cons, cpt, mbnd, mscor);
 	}
-	else if(tag)	// Motif's binding wasn't in stack, delete it.
-		mbnd.erase(mi);
-	else	// Motif's binding was in stack, recover it.
-		mscor[mi].depth = func_depths[didx];
+	else
+	{
+		if(tag)	// Motif's binding wasn't in stack, delete it.
+			mbnd.erase(mi);
+		else	// Motif's binding was in stack, recover it.
+			mscor[mi].didx = didx;
+		if(!jump)
+			rejmove[mk] = netver;
+	}
 
 	return s;
 }
@@ -408,13 +1409,16 @@ double updepth(int mi, vector<Constraint>& cons, vector<CPTRow>& cpt, double s,
 	}
 	if(!tag)
 		return s;
+	long long mk = movekey(nrule, mi, -1);	// depth move of the motif.
+	if(!jump && unchanged(mk))
+		return s;
 
 	string motif = mscor[mi].name;
 #ifdef VERBOSE
-	cout << "Choosing a new depth for motif " << motif;
+	vout() << "Choosing a new depth for motif " << motif;
 #endif
 	// Backup the original binding index.
-	int didx = depidx(mscor[mi].depth);
+	int didx = mscor[mi].didx;
 	double s0 = 1.0;	// Best Bayesian score.
 	vector<Constraint> cons0 = cons;	// Best constraints.
 	vector<CPTRow> cpt0;	// Best CPT.
@@ -424,48 +1428,20 @@ double updepth(int mi, vector<Constraint>& cons, vector<CPTRow>& cpt, double s,
 	{
 		if(i == didx)	// skip original depth.
 			continue;
-		mscor[mi].depth = func_depths[i];
+		mscor[mi].didx = i;
 		for(size_t j = 0; j < cons.size(); j++)	// consider all parameters for constraints that contain motif "mi".
 		{
 			if(mi != cons[j].motif0 && mi != cons[j].motif1)
 				continue;
 
-			vector<int> paraset;	// set up a set of parameters for tuning.
-			if(cons[j].desc == "pres" || cons[j].desc == "sec")
-				paraset.push_back(-1);
-			else if(cons[j].desc == "tss")
-			{
-				for(int k = 0; k < ntsst; k++)
-					paraset.push_back(tss_thrds[k]);
-			}
-			else if(cons[j].desc == "orien" || cons[j].desc == "order")
-			{
-				for(int k = 0; k < 2; k++)
-					paraset.push_back(k);
-			}
-			else if(cons[j].desc == "dist")
-			{
-				for(int k = 0; k < ndistt; k++)
-					paraset.push_back(dist_thrds[k]);
-			}
-			else if(cons[j].desc == "loop")
-			{
-				for(int k = 0; k < nloopt; k++)
-					paraset.push_back(loop_thrds[k]);
-			}
-
 			// Try different parameters.
-			for(size_t k = 0; k < paraset.size(); k++)
+			vector<int> ps = paraset(cons[j].desc);
+			for(size_t k = 0; k < ps.size(); k++)
 			{
 				vector<Constraint> cons1 = cons0;
-				cons1[j].para = paraset[k];
-				vector<CPTRow> cpt1, ppt1;
-				constrcpt(cpt1, ppt1, genlst, cons1);
-				double s1;
-				if(!itag)
-					s1 = score((int)cons1.size(), cpt1, ppt1);
-				else
-					s1 = iscore((int)cons1.size(), cpt1);
+				cons1[j].para = ps[k];
+				vector<CPTRow> cpt1;
+				double s1 = evalnet(cpt1, genlst, cons1);
 				if(s1 > s0 || s0 == 1)	// Store the best data structures.
 				{
 					cons0 = cons1;
@@ -477,23 +1453,28 @@ double updepth(int mi, vector<Constraint>& cons, vector<CPTRow>& cpt, double s,
 		}
 	}
 #ifdef VERBOSE
-	cout << " ..." << s0 << "(" << s << ")" << endl;
+	vout() << " ..." << s0 << "(" << s << ")" << endl;
 #endif	
-	if(s0 > s || (1/Temp*(s0-s) > log10((double)rand()/RAND_MAX) && jump))	// Use temperature to control jumping.
+	if(s0 > s || jumpto(s0, s, jump))	// Use temperature to control jumping.
 	{
 #ifdef VERBOSE
-		cout << "Accepting depth change: " << func_depths[didx0] << "(" << func_depths[didx] << ")" << endl;
+		vout() << "Accepting depth change: " << func_depths[didx0] << "(" << func_depths[didx] << ")" << endl;
 #endif
 		s = s0;
 		cons = cons0;
 		cpt = cpt0;
-		mscor[mi].depth = func_depths[didx0];
+		mscor[mi].didx = didx0;
 		chng++;	// Increase counter if accept depth change.
+		netver++;
 		if(tagbests)
 			bestsolu(s, cons, cpt, mbnd, mscor);
 	}
 	else
-		mscor[mi].depth = func_depths[didx];
+	{
+		mscor[mi].didx = didx;
+		if(!jump)
+			rejmove[mk] = netver;
+	}
 
 	return s;
 }
@@ -502,18 +1483,36 @@ double updepth(int mi, vector<Constraint>& cons, vector<CPTRow>& cpt, double s,
 double addcons(vector<Constraint>& cons, vector<CPTRow>& cpt, Constraint c, double s, 
 			   const vector<Case>& genlst, const int paraset[], int npara, bool jump)
 {
+	// Presence is added on a copy of the network by addpres, which tracks it itself.
+	bool det = (!jump && c.desc != "pres");
+	long long mk = movekey(ruleid(c.desc), c.motif0, c.motif1);
+	if(det && unchanged(mk))
+		return s;
+	// Greedy acceptance needs a higher score, so a rule whose bound can't reach 
+	// the current score is skipped; a margin covers rounding of the sums.
+	const double margin = 1e-9;
+	bool prune = (!jump && s != 1 && prior == 0 && !itag && !cons.empty() && (int)cons.size() < maxpa);
+	if(prune && netbound(cpt, (int)cons.size() + 1, INT_MAX, INT_MAX) < s - margin)
+	{
+		bndrule++;
+		if(det)
+			rejmove[mk] = netver;
+		return s;
+	}
+	vector<unsigned long long> pmask, nmask;	// positive and negative genes.
+	bool boxtag = prune && labmask(genlst, pmask, nmask);
 	if(c.desc != "pres")
 	{
 #ifdef VERBOSE
-		cout << "Considering constraint: " << c.desc << " of " << mscor[c.motif0].name;
+		vout() << "Considering constraint: " << c.desc << " of " << mscor[c.motif0].name;
 		if(c.motif1 != -1)
-			cout << " and " << mscor[c.motif1].name;
+			vout() << " and " << mscor[c.motif1].name;
 #endif
 	}
 	if((int)cons.size() >= maxpa)
 	{
 #ifdef VERBOSE
-		cout << " ...Reach maximum number of parents...Skip!" << endl;
+		vout() << " ...Reach maximum number of parents...Skip!" << endl;
 #endif
 		return s;
 	}
@@ -524,14 +1523,25 @@ double addcons(vector<Constraint>& cons, vector<CPTRow>& cpt, Constraint c, doub
 	for(int i = 0; i < npara; i++)
 	{
 		c.para = paraset[i];
+		if(boxtag)	// bound by the genes satisfying this parameter.
+		{
+			ConsBits pb = consbits(c);
+			int n0 = 0, n1 = 0;
+			for(size_t w = 0; w < pb->size(); w++)
+			{
+				n0 += __builtin_popcountll((*pb)[w] & nmask[w]);
+				n1 += __builtin_popcountll((*pb)[w] & pmask[w]);
+			}
+			double thrd = (s0 == 1 || s0 < s)? s : s0;	// score to beat.
+			if(netbound(cpt, (int)cons.size() + 1, n0, n1) < thrd - margin)
+			{
+				bndpara++;
+				continue;
+			}
+		}
 		cons1 = cons;
 		cons1.push_back(c);
-		vector<CPTRow> ppt1;
-		constrcpt(cpt1, ppt1, genlst, cons1);
-		if(!itag)
-			s1 = score((int)cons1.size(), cpt1, ppt1);
-		else
-			s1 = iscore((int)cons1.size(), cpt1);
+		s1 = evalnet(cpt1, genlst, cons1);
 		if(s1 > s0 || s0 == 1)
 		{
 			s0 = s1;
@@ -539,13 +1549,19 @@ double addcons(vector<Constraint>& cons, vector<CPTRow>& cpt, Constraint c, doub
 			cpt0 = cpt1;
 		}
 	}
+	if(s0 == 1)	// every parameter was pruned.
+	{
+		if(det)
+			rejmove[mk] = netver;
+		return s;
+	}
 	if(c.desc != "pres")
 	{
 #ifdef VERBOSE
-		cout << " ..." << s0 << "(" << s << ")" << endl;
+		vout() << " ..." << s0 << "(" << s << ")" << endl;
 #endif
 	}
-	if(s0 > s || s == 1 || (1/Temp*(s0-s) > log10((double)rand()/RAND_MAX) && jump))	// Use jumping depends on switch.
+	if(s0 > s || s == 1 || jumpto(s0, s, jump))	// Use jumping depends on switch.
 	{
 		s = s0;
 		cons = cons0;
@@ -553,13 +1569,16 @@ double addcons(vector<Constraint>& cons, vector<CPTRow>& cpt, Constraint c, doub
 		if(c.desc != "pres")
 		{
 #ifdef VERBOSE
-			cout << "Accepting constraint: " << c.desc << endl;
+			vout() << "Accepting constraint: " << c.desc << endl;
 #endif
 			chng++;	// Increase counter if accept adding constraint.
+			netver++;
 			if(tagbests)
 				bestsolu(s, cons, cpt, mbnd, mscor);
 		}
 	}
+	else if(det)
+		rejmove[mk] = netver;
 	return s;
 }
 
@@ -575,32 +1594,28 @@ double delcons(vector<Constraint>& cons, vector<CPTRow>& cpt, double s, const ve
 			if(cons.size() <= 1)	// stop before all constraints are removed.
 				break;
 #ifdef VERBOSE
-			cout << "Deleting constraint " << cons[i].desc << " of " << mscor[cons[i].motif0].name;
+			vout() << "Deleting constraint " << cons[i].desc << " of " << mscor[cons[i].motif0].name;
 			if(cons[i].motif1 != -1)
-				cout << " and " << mscor[cons[i].motif1].name;
+				vout() << " and " << mscor[cons[i].motif1].name;
 #endif
 			vector<Constraint> cons1 = cons;
 			cons1.erase(cons1.begin() + i);
-			vector<CPTRow> cpt1, ppt;
-			constrcpt(cpt1, ppt, genlst, cons1);
-			double s1;
-			if(!itag)
-				s1 = score((int)cons1.size(), cpt1, ppt);
-			else
-				s1 = iscore((int)cons1.size(), cpt1);
+			vector<CPTRow> cpt1;
+			double s1 = evalnet(cpt1, genlst, cons1);
 #ifdef VERBOSE
-			cout << " ..." << s1 << "(" << s << ")" << endl;
+			vout() << " ..." << s1 << "(" << s << ")" << endl;
 #endif
 			if(s1 > s)	// Deletion is greedy.
 			{
 #ifdef VERBOSE
-				cout << "Accepting deletion" << endl;
+				vout() << "Accepting deletion" << endl;
 #endif
 				tag = true;
 				cons = cons1;
 				cpt = cpt1;
 				s = s1;
 				chng++;	// Increase counter if accept deletion.
+				netver++;
 				break;
 			}
 		}
@@ -624,6 +1639,8 @@ double delcons(vector<Constraint>& cons, vector<CPTRow>& cpt, double s, const ve
 	}
 	for(size_t i = 0; i < vdel.size(); i++)
 		mbnd.erase(vdel[i]);
+	if(!vdel.empty())
+		netver++;
 
 	if(tagbests)
 		bestsolu(s, cons, cpt, mbnd, mscor);
@@ -631,6 +1648,134 @@ double delcons(vector<Constraint>& cons, vector<CPTRow>& cpt, double s, const ve
 	return s;
 }
 
+// Propose one random change of the network and accept it by Metropolis-Hastings 
+// at temperature "Temp", on the same scale as the other moves of gbnet. Adding a 
+// constraint with a random parameter (and depth of a new motif), deleting one, 
+// changing a motif's depth and changing a parameter are each proposed with 
+// probability 1/4. The Hastings ratio corrects for the different number of moves 
+// from the two networks; a move whose reverse can't be proposed is rejected.
+static double mhmove(vector<Constraint>& cons, vector<CPTRow>& cpt, double s, const vector<Case>& genlst)
+{
+	vector<Constraint> cons1 = cons;
+	set<int> mb1 = mbnd;
+	double lq = 0;	// log10 of q(new -> old)/q(old -> new).
+	int mi = -1, didx = -1;	// motif whose depth is proposed and its depth.
+	int kind = (int)(unirand()*4);
+	if(kind == 0)	// add.
+	{
+		vector<Constraint> va;
+		addable(cons, mbnd, va);
+		if(va.empty())
+			return s;
+		Constraint c = va[(int)(unirand()*va.size())];
+		vector<int> ps = paraset(c.desc);
+		c.para = ps[(int)(unirand()*ps.size())];
+		lq -= log10(1.0/va.size()) + log10(1.0/ps.size());
+		if(mb1.find(c.motif0) == mb1.end())	// a new motif enters at a random depth.
+		{
+			mi = c.motif0;
+			didx = mscor[mi].didx;
+			mscor[mi].didx = (int)(unirand()*nfunc);
+			mb1.insert(mi);
+			lq -= log10(1.0/nfunc);
+		}
+		cons1.push_back(c);
+		lq += log10(1.0/cons1.size());	// reverse: delete it.
+	}
+	else if(kind == 1)	// delete.
+	{
+		if(cons.size() <= 1)	// keep at least one constraint.
+			return s;
+		int j = (int)(unirand()*cons.size());
+		Constraint c = cons[j];
+		cons1.erase(cons1.begin() + j);
+		lq -= log10(1.0/cons.size());
+		mb1.clear();
+		for(size_t i = 0; i < cons1.size(); i++)
+		{
+			mb1.insert(cons1[i].motif0);
+			if(cons1[i].motif1 != -1)
+				mb1.insert(cons1[i].motif1);
+		}
+		vector<Constraint> va;	// reverse: add it again.
+		addable(cons1, mb1, va);
+		bool tag = false;
+		for(size_t i = 0; i < va.size() && !tag; i++)
+			tag = (va[i].desc == c.desc && va[i].motif0 == c.motif0 && va[i].motif1 == c.motif1);
+		if(!tag)
+			return s;
+		lq += log10(1.0/va.size()) + log10(1.0/paraset(c.desc).size());
+		if(mb1.find(c.motif0) == mb1.end())
+			lq += log10(1.0/nfunc);
+	}
+	else if(kind == 2)	// depth; the reverse is as likely.
+	{
+		if(mbnd.empty() || nfunc < 2)
+			return s;
+		set<int>::const_iterator m = mbnd.begin();
+		advance(m, (int)(unirand()*mbnd.size()));
+		mi = *m;
+		didx = mscor[mi].didx;
+		int d = (int)(unirand()*(nfunc - 1));
+		mscor[mi].didx = (d < didx)? d : d + 1;
+	}
+	else	// parameter; the reverse is as likely.
+	{
+		vector<int> vj;
+		for(size_t i = 0; i < cons.size(); i++)
+		{
+			if(paraset(cons[i].desc).size() > 1)
+				vj.push_back((int)i);
+		}
+		if(vj.empty())
+			return s;
+		int j = vj[(int)(unirand()*vj.size())];
+		vector<int> ps = paraset(cons[j].desc);
+		ps.erase(find(ps.begin(), ps.end(), cons[j].para));
+		cons1[j].para = ps[(int)(unirand()*ps.size())];
+	}
+
+	vector<CPTRow> cpt1;
+	double s1 = evalnet(cpt1, genlst, cons1);
+	bool a = log10(unirand()) < (s1 - s)/Temp + lq;
+	if(s1 < s)	// worse networks are counted for the adaptive schedule.
+	{
+		upprop++;
+		if(calib)
+		{
+			updelta.push_back(s - s1);
+			a = false;
+		}
+		else if(a)
+			upacc++;
+	}
+	if(a)
+	{
+		mhacc++;
+		chng++;
+		netver++;
+		s = s1;
+		cons = cons1;
+		cpt = cpt1;
+		mbnd = mb1;
+		if(tagbests)
+			bestsolu(s, cons, cpt, mbnd, mscor);
+	}
+	else if(mi != -1)
+		mscor[mi].didx = didx;
+	return s;
+}
+
+// One Metropolis-Hastings step, counted and timed for the cache report.
+double mhstep(vector<Constraint>& cons, vector<CPTRow>& cpt, double s, const vector<Case>& genlst)
+{
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+	mhprop++;
+	s = mhmove(cons, cpt, s, genlst);
+	mhnsec += (long)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - t0).count();
+	return s;
+}
+
 // Check whether a constraint has already been added.
 bool chkcons(const vector<Constraint>& cons, const string& desc, int motif0, int motif1)
 {
@@ -655,6 +1800,12 @@ int outbayes(ofstream& hOut, double s, const vector<Constraint>& cons, const vec
 		hOut << "Number of required changes: " << Changes << endl;
 		hOut << "Temperature changing rate Alpha: " << Alpha << endl;
 		hOut << "Initial temperature: " << Initemp << endl << endl;
+		if(adaptsa)
+		{
+			hOut << "Adaptive schedule: target acceptance " << tgtacc << ", patience " << patience << " evaluations" << endl;
+			hOut << "Calibrated initial temperature: " << calitemp << endl;
+			hOut << "Networks evaluated: " << nevals << endl << endl;
+		}
 	}
 	hOut << "Candidate motifs: " << motifcand << endl;
 	hOut << "Use prior information for preferred motifs? " << prior << endl;
@@ -746,9 +1897,9 @@ vector<CPTRow> ebitcpt(const vector<CPTRow>& cpt, size_t nc)
 void outcons(ofstream& h, const Constraint& c, const vector<MotifScore>& mscor)
 {
 	if(c.desc == "pres")
-		h << "Presence of " << mscor[c.motif0].name << ":" << mscor[c.motif0].depth << endl;
+		h << "Presence of " << mscor[c.motif0].name << ":" << func_depths[mscor[c.motif0].didx] << endl;
 	else if(c.desc == "tss")
-		h << "Distance to TSS of " << mscor[c.motif0].name << ":" << c.para << ", " << mscor[c.motif0].depth << endl;
+		h << "Distance to TSS of " << mscor[c.motif0].name << ":" << c.para << ", " << func_depths[mscor[c.motif0].didx] << endl;
 	else if(c.desc == "orien")
 	{
 		h << "Orientation of " << mscor[c.motif0].name << ":";
@@ -756,32 +1907,32 @@ void outcons(ofstream& h, const Constraint& c, const vector<MotifScore>& mscor)
 			h << "F";
 		else if(c.para == 1)
 			h << "R";
-		h << ", " << mscor[c.motif0].depth << endl;
+		h << ", " << func_depths[mscor[c.motif0].didx] << endl;
 	}
 	else if(c.desc == "sec")
-		h << "Second copy of " << mscor[c.motif0].name << ", " << mscor[c.motif0].depth << endl;
+		h << "Second copy of " << mscor[c.motif0].name << ", " << func_depths[mscor[c.motif0].didx] << endl;
 	else if(c.desc == "dist")
 		h << "Distance between " << mscor[c.motif0].name << " and " << mscor[c.motif1].name << ":" << c.para 
-		<< ", (" << mscor[c.motif0].depth << "," << mscor[c.motif1].depth << ")" << endl;
+		<< ", (" << func_depths[mscor[c.motif0].didx] << "," << func_depths[mscor[c.motif1].didx] << ")" << endl;
 	else if(c.desc == "order")
 	{
 		if(c.para == 0)
 			h << mscor[c.motif0].name << " is before " << mscor[c.motif1].name << ":" << c.para 
-			<< ", (" << mscor[c.motif0].depth << "," << mscor[c.motif1].depth << ")" << endl;
+			<< ", (" << func_depths[mscor[c.motif0].didx] << "," << func_depths[mscor[c.motif1].didx] << ")" << endl;
 		else if(c.para == 1)
 			h << mscor[c.motif1].name << " is before " << mscor[c.motif0].name << ":" << c.para 
-			<< ", (" << mscor[c.motif1].depth << "," << mscor[c.motif0].depth << ")" << endl;
+			<< ", (" << func_depths[mscor[c.motif1].didx] << "," << func_depths[mscor[c.motif0].didx] << ")" << endl;
 	}
 	else if(c.desc == "loop")
 		h << "Looping of " << mscor[c.motif0].name << " and " << mscor[c.motif1].name << ":" << c.para 
-		<< ", (" << mscor[c.motif0].depth << "," << mscor[c.motif1].depth << ")" << endl;
+		<< ", (" << func_depths[mscor[c.motif0].didx] << "," << func_depths[mscor[c.motif1].didx] << ")" << endl;
 }
 
 // Output all motif scores and optimal functional depths to file.
 void outscor(ofstream& h, const vector<MotifScore>& mscor)
 {
 	for(size_t i = 0; i < mscor.size(); i++)
-		h << mscor[i].name << "\t" << mscor[i].score << "\t" << mscor[i].depth << endl;
+		h << mscor[i].name << "\t" << mscor[i].score << "\t" << func_depths[mscor[i].didx] << endl;
 }
 
 // Format a non-negative integer to a string using binary representation.
@@ -818,9 +1969,11 @@ int loadscor(vector<MotifScore>& mscor, const string& s)
 			continue;
 		istringstream strmLn(strLn);
 		MotifScore ascor;
-		strmLn >> ascor.name >> ascor.score >> ascor.depth;
+		double depth;
+		strmLn >> ascor.name >> ascor.score >> depth;
 		if(ascor.name[0] == '*')
 			continue;
+		ascor.didx = depidx(depth);
 		mscor.push_back(ascor);
 	}
 	hScor.close();
@@ -856,6 +2009,8 @@ int loadgene(vector<Case>& tlst, vector<Case>& blst, const string& n, const stri
 		Case c;
 		c.name = gene;
 		c.label = 1;
+		c.gi = -1;
+		c.wt = 1;
 		tlst.push_back(c);
 	}
 	hGen.close();
@@ -881,6 +2036,8 @@ int loadgene(vector<Case>& tlst, vector<Case>& blst, const string& n, const stri
 		Case c;
 		c.name = gene;
 		c.label = 0;
+		c.gi = -1;
+		c.wt = 1;
 		blst.push_back(c);
 	}
 	hBkg.close();
@@ -913,273 +2070,1020 @@ int loadmotif(vector<string>& motiflst, const string& f)
 	return 0;
 }
 
+// Index all genes whose binding will be loaded.
+int mkgidx(const set<string>& genset)
+{
+	gidx.clear();
+	gnames.clear();
+	for(set<string>::const_iterator i = genset.begin(); i != genset.end(); i++)
+	{
+		gidx[*i] = (int)gnames.size();
+		gnames.push_back(*i);
+	}
+	return (int)gnames.size();
+}
+
+// Set index in binding for each case.
+void setgidx(vector<Case>& genlst)
+{
+	for(size_t i = 0; i < genlst.size(); i++)
+	{
+		map<string, int>::const_iterator gi = gidx.find(genlst[i].name);
+		genlst[i].gi = (gi != gidx.end())? gi->second : -1;
+	}
+}
+
+// Skip blanks of a line.
+static const char* skipblank(const char* p, const char* e)
+{
+	while(p < e && (*p == ' ' || *p == '\t' || *p == '\r'))
+		p++;
+	return p;
+}
+
+// End of a token in a line.
+static const char* endtoken(const char* p, const char* e)
+{
+	while(p < e && *p != ' ' && *p != '\t' && *p != '\r')
+		p++;
+	return p;
+}
+
 // Load one motif's binding.
-int loadone(GBMap& onebind, const string& motif, const set<string>& genset, const string& folder)
+// The file is read in one block and parsed in place; sites of genes 
+// that are not indexed are skipped without being parsed.
+int loadone(MotifBind& onebind, const string& motif, const string& folder)
 {
 	string fBind = folder + "/" + motif + ".func";
-	ifstream hBind(fBind.data());
+	ifstream hBind(fBind.data(), ios::binary);
 	if(!hBind)
 	{
 		cerr << "Can't open " << fBind << endl;
 		return 1;
 	}
-	while(hBind.good())
-	{
-		string strLn;
-		getline(hBind, strLn);
-		if(strLn == "")
+	hBind.seekg(0, ios::end);
+	vector<char> buf((size_t)hBind.tellg());
+	hBind.seekg(0, ios::beg);
+	if(!buf.empty())
+		hBind.read(&buf[0], buf.size());
+	hBind.close();
+
+	// Sites are read in file order first and then packed by gene index.
+	vector<int> first(gnames.size(), -1);	// first site of each gene.
+	vector<int> nsite(gnames.size(), 0);	// number of sites of each gene.
+	vector<int> loc;
+	vector<unsigned char> bin;
+	string gene;	// reused for each line.
+	const char* p = buf.data();
+	const char* end = p + buf.size();
+	while(p < end)
+	{
+		const char* eol = (const char*)memchr(p, '\n', end - p);
+		if(eol == NULL)
+			eol = end;
+		p = skipblank(p, eol);
+		if(p == eol)	// empty line.
+		{
+			p = eol + 1;
 			continue;
-		istringstream gStrm(strLn);
-		string gene;
-		int nb;
-		gStrm >> gene >> nb;
+		}
+		const char* q = endtoken(p, eol);
+		gene.assign(p, q);
 		str2upper(gene);
-		if(genset.find(gene) == genset.end())
+		map<string, int>::const_iterator gi = gidx.find(gene);
+		if(gi == gidx.end())
+		{
+			p = eol + 1;
 			continue;
-		VGB vgb;
-		for(int j = 0; j < nb; j++)
+		}
+		int nb = 0;
+		p = skipblank(q, eol);
+		p = from_chars(p, eol, nb).ptr;
+		first[gi->second] = (int)loc.size();
+		int j = 0;
+		for(; j < nb; j++)
+		{
+			p = skipblank(p, eol);
+			if(p == eol)
+				break;
+			q = endtoken(p, eol);
+			unsigned char b;
+			int l;
+			extrbnd(p, q, b, l);
+			bin.push_back(b);
+			loc.push_back(l);
+			p = q;
+		}
+		nsite[gi->second] = j;
+		p = eol + 1;
+	}
+
+	onebind.off.assign(gnames.size() + 1, 0);
+	for(size_t g = 0; g < gnames.size(); g++)
+	{
+		if(first[g] < 0)
 		{
-			string site;
-			gStrm >> site;
-			vgb.e.push_back(extrbnd(site));
+			string msg = "Motif " + motif + " binding info absent for gene: " + gnames[g] + " assume no binding\n";
+			cerr << msg;
 		}
-		onebind.e[gene] = vgb;
+		onebind.off[g+1] = onebind.off[g] + nsite[g];
+	}
+	onebind.loc.resize(onebind.off.back());
+	onebind.bin.resize(onebind.off.back());
+	for(size_t g = 0; g < gnames.size(); g++)
+	{
+		if(nsite[g] == 0)
+			continue;
+		copy(loc.begin() + first[g], loc.begin() + first[g] + nsite[g], onebind.loc.begin() + onebind.off[g]);
+		copy(bin.begin() + first[g], bin.begin() + first[g] + nsite[g], onebind.bin.begin() + onebind.off[g]);
 	}
 	return 0;
 }
 
 // Load all motifs' binding.
-int loadbind(MotifMap& allbind, const vector<string>& motiflst, const set<string>& genset, const string& folder)
+// Different motifs' files are loaded concurrently.
+int loadbind(MotifMap& allbind, const vector<string>& motiflst, const string& folder)
 {
+	vector<shared_ptr<MotifBind> > vb(motiflst.size());
+	vector<int> err(motiflst.size(), 0);
+	parfor((int)motiflst.size(), [&](int i)
+	{
+		vb[i].reset(new MotifBind);
+		err[i] = loadone(*vb[i], motiflst[i], folder);
+	});
 	for(size_t i = 0; i < motiflst.size(); i++)
 	{
-		const string& motif = motiflst[i];
-		//GBMap onemap;	// Gene binding map for one motif only.
-		//pair<string, GBMap> elem(motif, onemap);	// An element for motif map.
-		//allbind.e.insert(elem);
-		if(loadone(allbind.e[motif], motif, genset, folder) != 0)
+		if(err[i] != 0)
 			return 1;
+		allbind.e[motiflst[i]] = vb[i];
 	}
 	return 0;
 }
 
 // A version for motif score list.
-int loadbind(MotifMap& allbind, const vector<MotifScore>& mscor, const set<string>& genset, const string& folder)
+int loadbind(MotifMap& allbind, const vector<MotifScore>& mscor, const string& folder)
+{
+	vector<string> motiflst;
+	for(size_t i = 0; i < mscor.size(); i++)
+		motiflst.push_back(mscor[i].name);
+	return loadbind(allbind, motiflst, folder);
+}
+
+// Check that binding files of all motifs can be opened.
+int chkbind(const vector<MotifScore>& mscor, const string& folder)
 {
 	for(size_t i = 0; i < mscor.size(); i++)
 	{
-		const string& motif = mscor[i].name;
-		//GBMap onemap;	// Gene binding map for one motif only.
-		//pair<string, GBMap> elem(motif, onemap);	// An element for motif map.
-		//allbind.e.insert(elem);
-		if(loadone(allbind.e[motif], motif, genset, folder) != 0)
+		string fBind = folder + "/" + mscor[i].name + ".func";
+		ifstream hBind(fBind.data());
+		if(!hBind)
+		{
+			cerr << "Can't open " << fBind << endl;
 			return 1;
+		}
+	}
+	return 0;
+}
+
+// Memory occupied by one motif's binding in bytes.
+size_t bindsize(const MotifBind& b)
+{
+	return sizeof(MotifBind) + b.off.capacity()*sizeof(int) + 
+		b.loc.capacity()*sizeof(int) + b.bin.capacity()*sizeof(unsigned char);
+}
+
+// Evict least recently used motifs until binding fits in "bndcap".
+// Motifs in the current network and the one just loaded are kept.
+static void evictbind(const string& keep)
+{
+	set<string> inuse;
+	inuse.insert(keep);
+	for(set<int>::const_iterator mi = mbnd.begin(); mi != mbnd.end(); mi++)
+		inuse.insert(mscor[*mi].name);
+	list<string>::iterator i = bndlru.end();
+	while(bndbytes > bndcap && i != bndlru.begin())
+	{
+		i--;
+		if(inuse.find(*i) != inuse.end())
+			continue;
+		map<string, shared_ptr<MotifBind> >::iterator b = allbind.e.find(*i);
+		bndbytes -= bindsize(*b->second);
+		allbind.e.erase(b);	// users still holding the binding keep it alive.
+		bndpos.erase(*i);
+		i = bndlru.erase(i);
+		bndevict++;
+	}
+}
+
+// Binding of one motif, loaded from "bfolder" on first use.
+// Binding loaded here is cached under "bndcap" bytes if the cap is set.
+BindPtr getbind(const string& motif)
+{
+	return getbind(motif, true);
+}
+
+// Eviction is left to the searching thread when "evict" is off,
+// since only it knows the motifs of its current network.
+static BindPtr getbind(const string& motif, bool evict)
+{
+	unique_lock<mutex> lk(bndmtx);
+	while(bndload.find(motif) != bndload.end())	// being loaded by another thread.
+		bndcv.wait(lk);
+	map<string, shared_ptr<MotifBind> >::iterator i = allbind.e.find(motif);
+	if(i != allbind.e.end())
+	{
+		bndhit++;
+		map<string, list<string>::iterator>::iterator p = bndpos.find(motif);
+		if(p != bndpos.end())	// move to the most recently used.
+			bndlru.splice(bndlru.begin(), bndlru, p->second);
+		return i->second;
+	}
+
+	bndmiss++;
+	bndload.insert(motif);
+	lk.unlock();
+	shared_ptr<MotifBind> onebind(new MotifBind);
+	loadone(*onebind, motif, bfolder);	// missing binding is taken as no binding.
+	lk.lock();
+	allbind.e[motif] = onebind;
+	bndlru.push_front(motif);
+	bndpos[motif] = bndlru.begin();
+	bndbytes += bindsize(*onebind);
+	if(bndbytes > bndpeak)
+		bndpeak = bndbytes;
+	if(bndcap > 0 && evict)
+		evictbind(motif);
+	bndload.erase(motif);
+	bndcv.notify_all();
+	return onebind;
+}
+
+// Load one motif's binding from "bfolder" for the calling thread to score alone.
+// Return 1 if its file can't be read.
+static int pinbind(const string& motif)
+{
+	shared_ptr<MotifBind> onebind(new MotifBind);
+	if(loadone(*onebind, motif, bfolder) != 0)
+		return 1;
+	lock_guard<mutex> lk(bndmtx);
+	if(allbind.e.find(motif) != allbind.e.end())	// a duplicate in the list is being scored.
+		return 0;
+	bndmiss++;
+	allbind.e[motif] = onebind;
+	bndbytes += bindsize(*onebind);
+	if(bndbytes > bndpeak)
+		bndpeak = bndbytes;
+	return 0;
+}
+
+// Release one motif's binding, however it was loaded.
+static void dropbind(const string& motif)
+{
+	lock_guard<mutex> lk(bndmtx);
+	map<string, shared_ptr<MotifBind> >::iterator b = allbind.e.find(motif);
+	if(b == allbind.e.end())
+		return;
+	bndbytes -= bindsize(*b->second);
+	allbind.e.erase(b);
+	map<string, list<string>::iterator>::iterator p = bndpos.find(motif);
+	if(p != bndpos.end())
+	{
+		bndlru.erase(p->second);
+		bndpos.erase(p);
+	}
+}
+
+// Output the best score over time of the last beam or tabu search of the calling thread.
+void outtrace(ofstream& h)
+{
+	if(qtrace.empty())
+		return;
+	h << "Time to quality:" << endl << "Seconds\tBest score" << endl;
+	for(size_t i = 0; i < qtrace.size(); i++)
+		h << qtrace[i].first << "\t" << qtrace[i].second << endl;
+	h << endl;
+}
+
+// Output counters of binding and constraint cache, network table and exact search.
+void outcache(ofstream& h)
+{
+	lock_guard<mutex> lk(bndmtx);
+	h << "Binding cache: " << bndhit << " hits, " << bndmiss << " misses, " << bndevict << " evictions." << endl;
+	h << "Binding cache peak memory: " << (double)bndpeak/1048576 << " MB";
+	if(bndcap > 0)
+		h << " (cap " << (double)bndcap/1048576 << " MB)";
+	h << endl;
+	lock_guard<mutex> lc(consmtx);
+	h << "Constraint cache: " << conshit << " hits, " << consmiss << " misses, " 
+		<< (double)consbytes/1048576 << " MB." << endl;
+	h << "Network table: " << nethit << " hits, " << netmiss << " misses." << endl;
+	h << "Moves skipped on unchanged network: " << movskip << endl;
+	h << "Pruned by score bound: " << bndrule << " rules, " << bndpara << " parameters." << endl;
+	if(mhprop > 0)
+		h << "MH kernel: " << mhprop << " proposals, " << mhacc << " accepted (" << 100.0*mhacc/mhprop << "%), " 
+			<< mhprop/(mhnsec*1e-9 + 1e-9) << " proposals per second." << endl;
+	if(exruns > 0)
+		h << "Exact search: " << exnodes << " networks visited, " << exprune << " subtrees pruned, " 
+			<< exstops << " of " << exruns << " runs out of budget." << endl;
+}
+
+// Load a motif's binding in background.
+void prefetch(const string& motif)
+{
+	{
+		lock_guard<mutex> lk(bndmtx);
+		if(allbind.e.find(motif) != allbind.e.end() || bndload.find(motif) != bndload.end())
+			return;
+	}
+	waitfetch();
+	fetcher = thread(static_cast<BindPtr (*)(const string&, bool)>(getbind), motif, false);
+}
+
+// Wait for background loading to finish.
+void waitfetch()
+{
+	if(fetcher.joinable())
+		fetcher.join();
+}
+
+// Extract binding of a site from a string.
+void extrbnd(const char* s, const char* e, unsigned char& bin, int& loc)
+{
+	const char* semi = (const char*)memchr(s + 2, ',', e - s - 2);
+	if(semi == NULL)
+		semi = e;
+	double score = 0.0;
+	from_chars(s + 2, semi, score);
+	bin = (unsigned char)depbin(score);
+	if(s[0] == 'R')
+		bin |= REVBIT;
+	loc = 0;
+	if(semi < e)
+		from_chars(semi + 1, e, loc);
+}
+
+// Comparing routine for sorting motif scores.
+bool cmp(MotifScore s0, MotifScore s1)
+{
+	// Arrange the TRANSFAC motifs on top if necessary.
+	/*if((s0.name[3] != 'X' || !isnum(s0.name[2])) && (s1.name[3] == 'X' && isnum(s1.name[2])))
+	return true;
+	else if((s0.name[3] == 'X' && isnum(s0.name[2])) && (s1.name[3] != 'X' || !isnum(s1.name[2])))
+	return false;
+	else*/
+	return s0.score > s1.score;
+}
+
+// Comparing routine for sorting motif pair scores.
+bool pcmp(const PairScore& s0, const PairScore& s1)
+{
+	return s0.score > s1.score;
+}
+
+// Check whether a character is a decimal number.
+bool isnum(char c)
+{
+	if(c - '0' >=0 && c - '0' <= 9)
+		return true;
+	else
+		return false;
+}
+
+// Display the candidate motifs and their scores.
+void dispscor(const vector<MotifScore>& mscor)
+{
+	for(size_t i = 0; i < mscor.size(); i++)
+		cout << mscor[i].name << "\t" << mscor[i].score << "\t" << func_depths[mscor[i].didx] << endl;
+}
+
+// Test whether a gene satisfies one constraint.
+int test(const Constraint& c, const MotifBind& b0, int d0, const MotifBind& b1, int d1, int g, int tss)
+{
+	if(g < 0 || (size_t)g + 1 >= b0.off.size())	// no binding for the gene.
+		return 0;
+	int s0 = b0.off[g], e0 = b0.off[g+1];	// range of motif0's sites.
+	if(c.desc == "pres")
+	{
+		for(int i = s0; i < e0; i++)
+		{
+			if((b0.bin[i] & DEPBITS) > d0)
+				return 1;
+		}
+	}
+	else if(c.desc == "tss")
+	{
+		for(int i = s0; i < e0; i++)
+		{
+			if((b0.bin[i] & DEPBITS) > d0 && abs(b0.loc[i]-tss) <= c.para)
+				return 1;
+		}
 	}
+	else if(c.desc == "orien")
+	{
+		for(int i = s0; i < e0; i++)
+		{
+			if((b0.bin[i] & DEPBITS) <= d0)
+				continue;
+			if(!(b0.bin[i] & REVBIT) && c.para == 0)
+				return 1;
+			else if((b0.bin[i] & REVBIT) && c.para == 1)
+				return 1;
+		}
+	}
+	else if(c.desc == "sec")
+	{
+		int count = 0;
+		for(int i = s0; i < e0; i++)
+		{
+			if((b0.bin[i] & DEPBITS) > d0)
+				count++;
+			if(count > 1)
+				return 1;
+		}
+	}
+	else if(c.desc == "dist" || c.desc == "order" || c.desc == "loop")
+	{
+		if((size_t)g + 1 >= b1.off.size())
+			return 0;
+		int s1 = b1.off[g], e1 = b1.off[g+1];	// range of motif1's sites.
+		for(int i = s0; i < e0; i++)
+		{
+			if((b0.bin[i] & DEPBITS) <= d0)
+				continue;
+			for(int j = s1; j < e1; j++)
+			{
+				if((b1.bin[j] & DEPBITS) <= d1)
+					continue;
+				if(c.desc == "dist" && abs(b0.loc[i] - b1.loc[j]) <= c.para)
+					return 1;
+				else if(c.desc == "order" && b0.loc[i] < b1.loc[j] && c.para == 0)
+					return 1;
+				else if(c.desc == "order" && b0.loc[i] > b1.loc[j] && c.para == 1)
+					return 1;
+				else if(c.desc == "loop" && abs(b0.loc[i] - b1.loc[j]) > c.para)
+					return 1;
+			}
+		}
+	}
+	else
+		return 0;
 	return 0;
 }
 
-// Extract binding of a site from a string.
-GBinding extrbnd(const string& s)
+// Translational(transcriptional) start site of a gene.
+int tsspos(int g)
+{
+	if(g < 0 || mtss.empty())
+		return 0;
+	map<string, int>::const_iterator t = mtss.find(gnames[g]);
+	return (t != mtss.end())? t->second : 0;	// only for tss rule.
+}
+
+// According to a set of constraints, classify a gene into a category. 
+// Different combinations of the constraints are described in the bits of an integer.
+int classification(const string& gene, const vector<Constraint>& cons)
+{
+	map<string, int>::const_iterator gi = gidx.find(gene);
+	if(gi == gidx.end())
+	{
+		cerr << "Binding info absent for gene: " << gene << " assume no binding" << endl;
+		return classification(-1, cons);
+	}
+	return classification(gi->second, cons);
+}
+
+// Overloading for gene index.
+int classification(int g, const vector<Constraint>& cons)
+{
+	int resbits = 0;
+	int mask = 1;
+	for(size_t i = 0; i < cons.size(); i++)
+	{
+		BindPtr p0 = getbind(mscor[cons[i].motif0].name);
+		const MotifBind& b0 = *p0;
+		int d0 = mscor[cons[i].motif0].didx;
+		int tag;
+		if(cons[i].motif1 == -1)	// single motif rules.
+			tag = test(cons[i], b0, d0, b0, -1, g, tsspos(g));
+		else
+		{
+			BindPtr p1 = getbind(mscor[cons[i].motif1].name);
+			const MotifBind& b1 = *p1;
+			int d1 = mscor[cons[i].motif1].didx;
+			tag = test(cons[i], b0, d0, b1, d1, g);
+		}
+		if(tag == 1)	// the gene satisfy the constraint.
+			resbits |= mask;	// bit operation to set the correponding bit to 1.
+		mask <<= 1;	// shift the mask to the next bit position.
+	}
+
+	return resbits;
+}
+
+// Rule of a constraint as a number.
+static int ruleid(const string& desc)
+{
+	for(int i = 0; i < nrule; i++)
+	{
+		if(desc == rules[i])
+			return i;
+	}
+	return -1;
+}
+
+// Number of a motif's name; the same in all threads.
+static int motifid(const string& motif)
 {
-	GBinding gb;
-	string orien = s.substr(0, s.find(','));
-	gb.orien = orien[0];
-	size_t semi = s.find(',', 2);
-	string score = s.substr(2, semi - 2);
-	gb.score = atof(score.data());
-	string loc = s.substr(semi + 1);
-	gb.loc = atoi(loc.data());
-
-	return gb;
+	map<string, int>::const_iterator i = motids.find(motif);
+	if(i != motids.end())
+		return i->second;
+	int id = (int)motids.size();
+	motids[motif] = id;
+	return id;
 }
 
-// Comparing routine for sorting motif scores.
-bool cmp(MotifScore s0, MotifScore s1)
+// Test all indexed genes against one constraint at the current depths.
+static ConsBits mkbits(const Constraint& c)
 {
-	// Arrange the TRANSFAC motifs on top if necessary.
-	/*if((s0.name[3] != 'X' || !isnum(s0.name[2])) && (s1.name[3] == 'X' && isnum(s1.name[2])))
-	return true;
-	else if((s0.name[3] == 'X' && isnum(s0.name[2])) && (s1.name[3] != 'X' || !isnum(s1.name[2])))
-	return false;
-	else*/
-	return s0.score > s1.score;
+	BindPtr p0 = getbind(mscor[c.motif0].name);
+	BindPtr p1 = (c.motif1 == -1)? p0 : getbind(mscor[c.motif1].name);
+	int d0 = mscor[c.motif0].didx;
+	int d1 = (c.motif1 == -1)? -1 : mscor[c.motif1].didx;
+	bool tagtss = (c.desc == "tss");
+	vector<unsigned long long>* bits = new vector<unsigned long long>((gnames.size() + 63)/64, 0);
+	for(size_t g = 0; g < gnames.size(); g++)
+	{
+		if(test(c, *p0, d0, *p1, d1, (int)g, tagtss? tsspos((int)g) : 0) == 1)
+			(*bits)[g >> 6] |= 1ULL << (g & 63);
+	}
+	return ConsBits(bits);
 }
 
-// Check whether a character is a decimal number.
-bool isnum(char c)
+// Genes in the index that satisfy one constraint at the current depths.
+// Bitmaps do not depend on gene labels, so they are cached for all runs
+// under "conscap" bytes and the least recently used ones are dropped.
+ConsBits consbits(const Constraint& c)
 {
-	if(c - '0' >=0 && c - '0' <= 9)
-		return true;
-	else
-		return false;
+	ConsKey k;
+	k.rule = ruleid(c.desc);
+	k.para = c.para;
+	k.d0 = mscor[c.motif0].didx;
+	k.d1 = (c.motif1 == -1)? -1 : mscor[c.motif1].didx;
+	{
+		lock_guard<mutex> lk(consmtx);
+		k.m0 = motifid(mscor[c.motif0].name);
+		k.m1 = (c.motif1 == -1)? -1 : motifid(mscor[c.motif1].name);
+		map<ConsKey, ConsEntry>::iterator i = conscache.find(k);
+		if(i != conscache.end())
+		{
+			conshit++;
+			conslru.splice(conslru.begin(), conslru, i->second.pos);
+			return i->second.bits;
+		}
+		consmiss++;
+	}
+
+	ConsBits bits = mkbits(c);	// computed outside the lock.
+	size_t nb = bits->size()*sizeof(unsigned long long);
+	lock_guard<mutex> lk(consmtx);
+	if(conscache.find(k) != conscache.end() || nb > conscap)	// computed by another thread.
+		return bits;
+	conslru.push_front(k);
+	ConsEntry e = {bits, conslru.begin()};
+	conscache[k] = e;
+	consbytes += nb;
+	while(consbytes > conscap)
+	{
+		consbytes -= conscache[conslru.back()].bits->size()*sizeof(unsigned long long);
+		conscache.erase(conslru.back());
+		conslru.pop_back();
+	}
+	return bits;
 }
 
-// Display the candidate motifs and their scores.
-void dispscor(const vector<MotifScore>& mscor)
+// Construct conditional probability table given gene list, constraints and motif binding.
+void constrcpt(vector<CPTRow>& cpt, vector<CPTRow>& ppt, const vector<Case>& genlst, const vector<Constraint>& cons)
 {
-	for(size_t i = 0; i < mscor.size(); i++)
-		cout << mscor[i].name << "\t" << mscor[i].score << "\t" << mscor[i].depth << endl;
+	if(cons.size() < 1)
+	{
+		cpt.clear();
+		return;
+	}
+	// Set prior CPT.
+	setprior(ppt, cons);
+	// Initialize the CPT.
+	initcpt(cpt, (size_t)pow((double)2, (int)cons.size()));
+	// Set each gene's bit of every constraint from the constraint's bitmap.
+	vector<int> tidx(genlst.size(), 0);
+	for(size_t i = 0; i < cons.size(); i++)
+	{
+		ConsBits pb = consbits(cons[i]);
+		const vector<unsigned long long>& bits = *pb;
+		for(size_t j = 0; j < genlst.size(); j++)
+		{
+			int g = genlst[j].gi;
+			if(g >= 0 && (bits[g >> 6] >> (g & 63) & 1))
+				tidx[j] |= 1 << i;
+		}
+	}
+	// Increase the corresponding CPT entry by each gene's weight.
+	for(size_t i = 0; i < genlst.size(); i++)
+	{
+		if(genlst[i].label == 0)
+			cpt[tidx[i]].k0 += genlst[i].wt;
+		else if(genlst[i].label == 1)
+			cpt[tidx[i]].k1 += genlst[i].wt;
+	}
 }
 
-// Test whether a gene satisfies one constraint.
-int test(const Constraint& c, const VGB& m0, double d0, const VGB& m1, double d1, int tss)
+// Score a network, taking its CPT from the table of visited networks if possible.
+// A network is keyed by rule, motifs, depths and parameter of each constraint in 
+// canonical order, so the same constraints added in another order are found too. 
+// Score is always computed from the CPT in the given order.
+double evalnet(vector<CPTRow>& cpt, const vector<Case>& genlst, const vector<Constraint>& cons)
 {
-	if(c.desc == "pres")
+	nevals++;
+	vector<CPTRow> ppt;
+	if(netcap == 0 || cons.empty())
+		constrcpt(cpt, ppt, genlst, cons);
+	else
 	{
-		for(size_t i = 0; i < m0.e.size(); i++)
+		size_t n = cons.size();
+		vector<vector<int> > vk(n);
+		for(size_t i = 0; i < n; i++)
 		{
-			if(m0.e[i].score >= d0)
-				return 1;
+			const Constraint& c = cons[i];
+			vk[i].push_back(ruleid(c.desc));
+			vk[i].push_back(c.motif0);
+			vk[i].push_back(mscor[c.motif0].didx);
+			vk[i].push_back(c.motif1);
+			vk[i].push_back((c.motif1 == -1)? -1 : mscor[c.motif1].didx);
+			vk[i].push_back(c.para);
+		}
+		vector<int> ord(n);	// constraints in canonical order.
+		for(size_t i = 0; i < n; i++)
+			ord[i] = (int)i;
+		sort(ord.begin(), ord.end(), [&vk](int a, int b) { return vk[a] < vk[b]; });
+		vector<int> key, pos(n);	// canonical position of each constraint.
+		for(size_t r = 0; r < n; r++)
+		{
+			key.insert(key.end(), vk[ord[r]].begin(), vk[ord[r]].end());
+			pos[ord[r]] = (int)r;
+		}
+		vector<int> cidx(1 << n, 0);	// canonical index of each CPT entry.
+		for(size_t t = 0; t < cidx.size(); t++)
+		{
+			for(size_t i = 0; i < n; i++)
+			{
+				if(t & (1 << i))
+					cidx[t] |= 1 << pos[i];
+			}
+		}
+
+		NetTab& nt = nettab? *nettab : owntab;
+		bool hit = false;
+		{
+			lock_guard<mutex> lk(nt.m);
+			map<vector<int>, NetEntry>::iterator e = nt.tab.find(key);
+			if(e != nt.tab.end())
+			{
+				hit = true;
+				nt.lru.splice(nt.lru.begin(), nt.lru, e->second.pos);
+				cpt.resize(cidx.size());
+				for(size_t t = 0; t < cidx.size(); t++)
+					cpt[t] = e->second.cpt[cidx[t]];
+			}
+		}
+		if(hit)
+		{
+			nethit++;
+			setprior(ppt, cons);
+		}
+		else
+		{
+			netmiss++;
+			constrcpt(cpt, ppt, genlst, cons);	// outside the lock, as it scans the genes.
+			lock_guard<mutex> lk(nt.m);
+			if(nt.tab.find(key) == nt.tab.end())
+			{
+				nt.lru.push_front(key);
+				NetEntry& ne = nt.tab[key];
+				ne.cpt.resize(cpt.size());
+				for(size_t t = 0; t < cidx.size(); t++)
+					ne.cpt[cidx[t]] = cpt[t];
+				ne.pos = nt.lru.begin();
+				if(nt.tab.size() > netcap)
+				{
+					nt.tab.erase(nt.lru.back());
+					nt.lru.pop_back();
+				}
+			}
 		}
 	}
-	else if(c.desc == "tss")
+	if(!itag)
+		return score((int)cons.size(), cpt, ppt);
+	else
+		return iscore((int)cons.size(), cpt);
+}
+
+// Presence scores of motifs streamed through the thread pool: the binding of each 
+// motif is loaded, scored at all depths and released, so at most one motif per 
+// thread is in memory. Return 1 if a binding file can't be read.
+int streamscor(vector<MotifScore>& vscor, const vector<string>& motiflst, const vector<Case>& genlst)
+{
+	vscor.assign(motiflst.size(), MotifScore());
+	atomic<bool> err(false);
+	parfor((int)motiflst.size(), [&](int i)
 	{
-		for(size_t i = 0; i < m0.e.size(); i++)
+		if(err || pinbind(motiflst[i]) != 0)
 		{
-			if(m0.e[i].score >= d0 && abs(m0.e[i].loc-tss) <= c.para)
-				return 1;
+			err = true;
+			return;
 		}
-	}
-	else if(c.desc == "orien")
+#ifdef VERBOSE
+		vout() << "Calculating score for motif " << motiflst[i] << "..." << endl;
+#endif
+		vscor[i] = presscor(motiflst[i], genlst);
+		dropbind(motiflst[i]);
+	});
+	return err? 1 : 0;
+}
+
+// Depth bin of the best site of a motif on one gene; 0 if it has no site.
+static int topbin(const MotifBind& b, int g)
+{
+	int top = 0;
+	if(g >= 0 && (size_t)g + 1 < b.off.size())
 	{
-		for(size_t i = 0; i < m0.e.size(); i++)
+		for(int k = b.off[g]; k < b.off[g+1]; k++)
 		{
-			if(m0.e[i].score < d0)
-				continue;
-			if(m0.e[i].orien == 'F' && c.para == 0)
-				return 1;
-			else if(m0.e[i].orien == 'R' && c.para == 1)
-				return 1;
+			if((b.bin[k] & DEPBITS) > top)
+				top = b.bin[k] & DEPBITS;
 		}
 	}
-	else if(c.desc == "sec")
+	return (top > nfunc)? nfunc : top;
+}
+
+// Score of the network of joint presence of two motifs at its best pair of depths, 
+// given the best bin of each motif on each case. Cases are counted by the bins of 
+// both motifs once, and suffix sums give the CPT of every pair of depths.
+static PairScore presspair(const vector<unsigned char>& t0, const vector<unsigned char>& t1, 
+						   const vector<Case>& genlst, const vector<CPTRow>& ppt)
+{
+	int nb = nfunc + 2;	// bins 0..nfunc and a zero border.
+	vector<CPTRow> h;
+	initcpt(h, (size_t)nb*nb);
+	for(size_t i = 0; i < genlst.size(); i++)
 	{
-		int count = 0;
-		for(size_t i = 0; i < m0.e.size(); i++)
+		CPTRow& r = h[t0[i]*nb + t1[i]];
+		if(genlst[i].label == 0)
+			r.k0 += genlst[i].wt;
+		else if(genlst[i].label == 1)
+			r.k1 += genlst[i].wt;
+	}
+	for(int i = nb - 2; i >= 0; i--)	// h[i, j] becomes the cases of bins at least i and j.
+	{
+		for(int j = nb - 2; j >= 0; j--)
 		{
-			if(m0.e[i].score >= d0)
-				count++;
-			if(count > 1)
-				return 1;
+			h[i*nb + j].k0 += h[(i+1)*nb + j].k0 + h[i*nb + j+1].k0 - h[(i+1)*nb + j+1].k0;
+			h[i*nb + j].k1 += h[(i+1)*nb + j].k1 + h[i*nb + j+1].k1 - h[(i+1)*nb + j+1].k1;
 		}
 	}
-	else if(c.desc == "dist")
-	{
-		for(size_t i = 0; i < m0.e.size(); i++)
+	PairScore ps;
+	ps.score = 1.0;
+	ps.didx0 = 0;
+	ps.didx1 = 0;
+	ps.desc = "pres";
+	ps.para = -1;
+	vector<CPTRow> cpt(4);	// bit 0 for motif0 present and bit 1 for motif1 present.
+	const CPTRow& all = h[0];
+	for(int d0 = 0; d0 < nfunc; d0++)
+	{
+		const CPTRow& p0 = h[(d0+1)*nb];
+		for(int d1 = 0; d1 < nfunc; d1++)
 		{
-			if(m0.e[i].score < d0)
-				continue;
-			for(size_t j = 0; j < m1.e.size(); j++)
+			const CPTRow& p1 = h[d1+1];
+			const CPTRow& both = h[(d0+1)*nb + d1+1];
+			cpt[3] = both;
+			cpt[1].k0 = p0.k0 - both.k0;
+			cpt[1].k1 = p0.k1 - both.k1;
+			cpt[2].k0 = p1.k0 - both.k0;
+			cpt[2].k1 = p1.k1 - both.k1;
+			cpt[0].k0 = all.k0 - p0.k0 - p1.k0 + both.k0;
+			cpt[0].k1 = all.k1 - p0.k1 - p1.k1 + both.k1;
+			double s;
+			if(!itag)
+				s = score(2, cpt, ppt);
+			else
+				s = iscore(2, cpt);
+			if(ps.score == 1 || s > ps.score)
 			{
-				if(m1.e[j].score < d1)
-					continue;
-				if(abs(m0.e[i].loc - m1.e[j].loc) <= c.para)
-					return 1;
+				ps.score = s;
+				ps.didx0 = d0;
+				ps.didx1 = d1;
 			}
 		}
 	}
-	else if(c.desc == "order")
+	return ps;
+}
+
+// Try distance and order of the sites of two motifs at the depths of their joint 
+// presence, and keep the best in "ps". Each case is scanned once for the closest 
+// pair of sites and whether a site of motif0 is before or after one of motif1.
+static void posspair(PairScore& ps, const MotifBind& b0, const MotifBind& b1, 
+					 const vector<Case>& genlst, const vector<CPTRow>& ppt)
+{
+	vector<int> mind(genlst.size(), INT_MAX);
+	vector<unsigned char> ord(genlst.size(), 0);	// bit 0: motif0 before motif1; bit 1: after.
+	for(size_t i = 0; i < genlst.size(); i++)
 	{
-		for(size_t i = 0; i < m0.e.size(); i++)
+		int g = genlst[i].gi;
+		if(g < 0 || (size_t)g + 1 >= b0.off.size() || (size_t)g + 1 >= b1.off.size())
+			continue;
+		for(int k0 = b0.off[g]; k0 < b0.off[g+1]; k0++)
 		{
-			if(m0.e[i].score < d0)
+			if((b0.bin[k0] & DEPBITS) <= ps.didx0)
 				continue;
-			for(size_t j = 0; j < m1.e.size(); j++)
+			for(int k1 = b1.off[g]; k1 < b1.off[g+1]; k1++)
 			{
-				if(m1.e[j].score < d1)
+				if((b1.bin[k1] & DEPBITS) <= ps.didx1)
 					continue;
-				if(m0.e[i].loc < m1.e[j].loc && c.para == 0)
-					return 1;
-				else if(m0.e[i].loc > m1.e[j].loc && c.para == 1)
-					return 1;
+				int d = abs(b0.loc[k0] - b1.loc[k1]);
+				if(d < mind[i])
+					mind[i] = d;
+				if(b0.loc[k0] < b1.loc[k1])
+					ord[i] |= 1;
+				else if(b0.loc[k0] > b1.loc[k1])
+					ord[i] |= 2;
 			}
 		}
 	}
-	else if(c.desc == "loop")
+	vector<CPTRow> cpt;
+	for(int t = 0; t < ndistt + 2; t++)	// each distance threshold, then order 0 and 1.
 	{
-		for(size_t i = 0; i < m0.e.size(); i++)
+		initcpt(cpt, 2);
+		for(size_t i = 0; i < genlst.size(); i++)
 		{
-			if(m0.e[i].score < d0)
-				continue;
-			for(size_t j = 0; j < m1.e.size(); j++)
-			{
-				if(m1.e[j].score < d1)
-					continue;
-				if(abs(m0.e[i].loc - m1.e[j].loc) > c.para)
-					return 1;
-			}
+			int x = (t < ndistt)? (mind[i] <= dist_thrds[t]) : (ord[i] >> (t - ndistt) & 1);
+			if(genlst[i].label == 0)
+				cpt[x].k0 += genlst[i].wt;
+			else if(genlst[i].label == 1)
+				cpt[x].k1 += genlst[i].wt;
+		}
+		double s;
+		if(!itag)
+			s = score(1, cpt, ppt);
+		else
+			s = iscore(1, cpt);
+		if(s > ps.score)
+		{
+			ps.score = s;
+			ps.desc = (t < ndistt)? "dist" : "order";
+			ps.para = (t < ndistt)? dist_thrds[t] : t - ndistt;
 		}
 	}
-	else
-		return 0;
-	return 0;
 }
 
-// According to a set of constraints, classify a gene into a category. 
-// Different combinations of the constraints are described in the bits of an integer.
-int classification(const string& gene, const vector<Constraint>& cons)
+// Score every pair of motifs in the list on the thread pool and keep the top "ntop".
+// The best site bin of each motif on each case is taken while its binding is loaded, 
+// so the binding is released right away unless distance and order are tried too; 
+// then the binding of all motifs stays in memory until every pair is scored.
+// Return 1 if a binding file can't be read.
+int pairscor(vector<PairScore>& vps, const vector<string>& motiflst, const vector<Case>& genlst, size_t ntop, bool tagpos)
 {
-	int resbits = 0;
-	int mask = 1;
-	for(size_t i = 0; i < cons.size(); i++)
+	size_t nm = motiflst.size();
+	vector<vector<unsigned char> > top(nm);	// best bin of each motif on each case.
+	atomic<bool> err(false);
+	parfor((int)nm, [&](int i)
 	{
-		int tag;
-		const string& mnam0 = mscor[cons[i].motif0].name;
-		if(allbind.e[mnam0].e.find(gene) == allbind.e[mnam0].e.end())
-			cerr << "Motif " << mnam0 << " binding info absent for gene: " << gene << " assume no binding" << endl;
-		const VGB& m0 = allbind.e[mnam0].e[gene];
-		double depth0 = mscor[cons[i].motif0].depth;
-		if(cons[i].desc == "pres" || cons[i].desc == "tss" || 
-			cons[i].desc == "orien" || cons[i].desc == "sec")
-		{
-			const VGB& m1 = m0;	// m1 is NULL.
-			double depth1 = -1;	// depth1 is invalid.
-			int tss;
-			if(mtss.find(gene) != mtss.end())	// only for tss rule.
-				tss = mtss[gene];
-			else
-				tss = 0;
-			tag = test(cons[i], m0, depth0, m1, depth1, tss);
-		}
-		else if(cons[i].desc == "dist" || cons[i].desc == "order" || 
-			cons[i].desc == "loop")
+		if(err || pinbind(motiflst[i]) != 0)
 		{
-			const string& mnam1 = mscor[cons[i].motif1].name;
-			if(allbind.e[mnam1].e.find(gene) == allbind.e[mnam1].e.end())
-				cerr << "Motif " << mnam1 << " binding info absent for gene: " << gene << " assume no binding" << endl;
-			const VGB& m1 = allbind.e[mnam1].e[gene];
-			double depth1 = mscor[cons[i].motif1].depth;
-			tag = test(cons[i], m0, depth0, m1, depth1);
+			err = true;
+			return;
 		}
-		if(tag == 1)	// the gene satisfy the constraint.
-			resbits |= mask;	// bit operation to set the correponding bit to 1.
-		mask <<= 1;	// shift the mask to the next bit position.
+		BindPtr pb = getbind(motiflst[i]);
+		top[i].resize(genlst.size());
+		for(size_t j = 0; j < genlst.size(); j++)
+			top[i][j] = (unsigned char)topbin(*pb, genlst[j].gi);
+		if(!tagpos)
+			dropbind(motiflst[i]);
+	});
+
+	vector<vector<PairScore> > best(nm);	// top pairs of each first motif.
+	if(!err)
+	{
+		parfor((int)nm, [&](int a)
+		{
+			mscor.assign(2, MotifScore());	// priors are set by the motif names of a pair.
+			mscor[0].name = motiflst[a];
+			Constraint pres0 = {"pres", 0, -1, -1}, pres1 = {"pres", 1, -1, -1}, dist = {"dist", 0, 1, -1};
+			vector<Constraint> cons;
+			vector<CPTRow> ppt1;
+			cons.push_back(dist);
+			setprior(ppt1, cons);
+			BindPtr pa;
+			if(tagpos)
+				pa = getbind(motiflst[a]);
+			vector<PairScore>& v = best[a];
+			for(size_t b = a + 1; b < nm; b++)
+			{
+				if(motiflst[b] == motiflst[a])
+					continue;
+				mscor[1].name = motiflst[b];
+				cons.clear();
+				cons.push_back(pres0);
+				cons.push_back(pres1);
+				vector<CPTRow> ppt2;
+				setprior(ppt2, cons);
+				PairScore ps = presspair(top[a], top[b], genlst, ppt2);
+				ps.name0 = motiflst[a];
+				ps.name1 = motiflst[b];
+				if(tagpos)
+					posspair(ps, *pa, *getbind(motiflst[b]), genlst, ppt1);
+				v.push_back(ps);
+			}
+			if(v.size() > ntop)
+			{
+				partial_sort(v.begin(), v.begin() + ntop, v.end(), pcmp);
+				v.resize(ntop);
+			}
+		});
+	}
+	if(tagpos)
+	{
+		for(size_t i = 0; i < nm; i++)
+			dropbind(motiflst[i]);
 	}
+	if(err)
+		return 1;
 
-	return resbits;
+	vps.clear();
+	for(size_t i = 0; i < nm; i++)
+		vps.insert(vps.end(), best[i].begin(), best[i].end());
+	stable_sort(vps.begin(), vps.end(), pcmp);
+	if(vps.size() > ntop)
+		vps.resize(ntop);
+	return 0;
 }
 
-// Construct conditional probability table given gene list, constraints and motif binding.
-void constrcpt(vector<CPTRow>& cpt, vector<CPTRow>& ppt, const vector<Case>& genlst, const vector<Constraint>& cons)
+// Presence score of one motif on a gene list at its best functional depth.
+// The search state of the calling thread is reset to this motif alone.
+// A gene is present at depth index j if its best site has a depth bin above j, 
+// so one pass over the sites gives the CPT of every depth from cumulative counts.
+MotifScore presscor(const string& motif, const vector<Case>& genlst)
 {
-	if(cons.size() < 1)
-	{
-		cpt.clear();
-		return;
-	}
-	// Set prior CPT.
+	mscor.clear();
+	mbnd.clear();
+	mbnd.insert(0);	// Always only one motif in the list.
+	MotifScore scor;	// scor is used to initialize mscor and store the best.
+	scor.name = motif;
+	scor.score = 1.0;
+	scor.didx = 0;
+	mscor.push_back(scor);
+
+	Constraint pres = {"pres", 0, -1, -1};
+	vector<Constraint> cons;
+	cons.push_back(pres);
+	vector<CPTRow> hist, ppt;	// weights of genes by the bin of their best site.
+	initcpt(hist, nfunc + 1);
 	setprior(ppt, cons);
-	// Initialize the CPT.
-	initcpt(cpt, (size_t)pow((double)2, (int)cons.size()));
-	// Classify each gene and increase the corresponding CPT entry by one.
+	BindPtr pb = getbind(motif);
 	for(size_t i = 0; i < genlst.size(); i++)
 	{
-		int tidx = classification(genlst[i].name, cons);
+		int top = topbin(*pb, genlst[i].gi);
 		if(genlst[i].label == 0)
-			cpt[tidx].k0++;
+			hist[top].k0 += genlst[i].wt;
 		else if(genlst[i].label == 1)
-			cpt[tidx].k1++;
+			hist[top].k1 += genlst[i].wt;
+	}
+	vector<CPTRow> cpt;	// absent and present genes at the current depth.
+	initcpt(cpt, 2);
+	for(int j = 0; j <= nfunc; j++)
+	{
+		cpt[1].k0 += hist[j].k0;
+		cpt[1].k1 += hist[j].k1;
+	}
+	for(int j = 0; j < nfunc; j++)
+	{
+#ifdef VERBOSE
+		vout() << "Choosing functional depth " << func_depths[j] << "..." << endl;
+#endif
+		cpt[0].k0 += hist[j].k0;	// genes whose best bin is j are absent from depth j on.
+		cpt[0].k1 += hist[j].k1;
+		cpt[1].k0 -= hist[j].k0;
+		cpt[1].k1 -= hist[j].k1;
+		double s;
+		if(!itag)
+			s = score(1, cpt, ppt);
+		else
+			s = iscore(1, cpt);
+		if(scor.score == 1 || s > scor.score)
+		{
+			scor.score = s;
+			scor.didx = j;
+		}
 	}
+	return scor;
 }
 
 // Initialize CPT.
@@ -1276,12 +3180,24 @@ string& str2upper(string& str)
 }
 
 // Calculate the log Gamma value given a integer.
+// Table of logamma for small x, summed in the same order as the loop below.
+static vector<double> lgtable(int n)
+{
+	vector<double> t(n, 0.0);
+	for(int x = 3; x < n; x++)
+		t[x] = t[x-1] + log10((double)(x-1));
+	return t;
+}
+
 double logamma(int x)
 {
+	static const vector<double> tab = lgtable(65536);
 	if(x <= 2)
 		return 0.0;
-	double v = 0.0;
-	for(int i = 2; i < x; i++)
+	if(x < (int)tab.size())
+		return tab[x];
+	double v = tab.back();
+	for(int i = (int)tab.size() - 1; i < x; i++)
 	{
 		v += log10((double)i);
 	}
@@ -1374,7 +3290,7 @@ vector<BPred> predict(const vector<Constraint>& cons, const vector<CPTRow>& cpt,
 	{
 		BPred bpred;
 		string gene = genlst[i].name;
-		int idx = classification(gene, cons);
+		int idx = classification(genlst[i].gi, cons);
 		bpred.prob = (double)cpt[idx].k1/(cpt[idx].k0+cpt[idx].k1);
 		bpred.label = label;
 		bpred.name = gene;
@@ -1419,7 +3335,7 @@ double restart(double s, vector<Constraint>& cons, vector<CPTRow>& cpt, int& ite
 	if(ng < DeterNum || bsolu.s - s > DeterScor)
 	{
 #ifdef VERBOSE
-		cout << "Bad condition happens! Restart SA with best solution..." << endl;
+		vout() << "Bad condition happens! Restart SA with best solution..." << endl;
 #endif
 		s = bsolu.s;
 		cons = bsolu.cons;
@@ -1429,7 +3345,231 @@ double restart(double s, vector<Constraint>& cons, vector<CPTRow>& cpt, int& ite
 		chng = 0;	// reset BN counter.
 		iter = -1;	// reset iteration counter. looper will automatically add one.
 		rests++;	// restarting counter add one.
+		netver++;
+	}
+	return s;
+}
+
+// Deadline of searches and the file rewritten with the best network so far.
+static chrono::steady_clock::time_point tldead;
+static volatile sig_atomic_t termed = 0;	// SIGTERM received.
+struct SnapFile{
+	string f;	// empty if no file is written.
+	vector<MotifScore> vms;
+	size_t node, bkg;
+	double s;	// score of the last network written.
+	thread::id tid;	// thread of the search.
+	RunConf conf;	// settings of the search.
+};
+static SnapFile snap;
+static mutex snapmtx;	// guard of the file for workers of the search.
+
+// Only set a flag: the search stops at its next check and its best network is output.
+static void onterm(int)
+{
+	termed = 1;
+}
+
+// Start the clock of "timelimit" and stop searches on SIGTERM.
+void setdeadline()
+{
+	tldead = chrono::steady_clock::now() + chrono::milliseconds((long long)(timelimit*1000));
+	signal(SIGTERM, onterm);
+}
+
+// Whether a search should stop now: past the time limit or SIGTERM received.
+bool timeup()
+{
+	return termed || (timelimit > 0 && chrono::steady_clock::now() > tldead);
+}
+
+// Rewrite file f with the best network of the search in the calling thread.
+void setsnap(const string& f, const vector<MotifScore>& vms, size_t node, size_t bkg)
+{
+	snap.f = f;
+	snap.vms = vms;
+	snap.node = node;
+	snap.bkg = bkg;
+	snap.s = 1;
+	snap.tid = this_thread::get_id();
+	snap.conf = getconf();
+}
+
+// Whether the calling thread runs the search whose networks setsnap writes.
+static bool snapping()
+{
+	return snap.f != "" && this_thread::get_id() == snap.tid;
+}
+
+// Write the network to the file of setsnap if it is better than the last one written.
+// It is written to a temporary file and renamed, so the file always holds whole results.
+void snapshot(double s, const vector<Constraint>& cons, const vector<CPTRow>& cpt)
+{
+	if(snapping())
+		snapshot(s, cons, cpt, mscor);
+}
+
+// Write a network on motifs "ms" found by the search of setsnap or by a worker of it, 
+// which writes with the settings of the search.
+static void snapshot(double s, const vector<Constraint>& cons, const vector<CPTRow>& cpt, const vector<MotifScore>& ms)
+{
+	lock_guard<mutex> lk(snapmtx);
+	if(snap.f == "" || (snap.s != 1 && s <= snap.s))
+		return;
+	snap.s = s;
+	string t = snap.f + ".tmp";
+	ofstream h(t.data());
+	if(!h)
+		return;
+	RunConf c = getconf();
+	vector<MotifScore> m = mscor;
+	setconf(snap.conf);
+	mscor = ms;
+	h << "Number of genes in category 1: " << snap.node << endl;
+	h << "Number of genes in category 0: " << snap.bkg << endl << endl;
+	int r = outbayes(h, s, cons, cpt, snap.vms, snap.node, snap.bkg);
+	h.close();
+	setconf(c);
+	mscor = m;
+	if(r == 0 && h)
+		rename(t.data(), snap.f.data());
+}
+
+// Write a network with motif names and depths so that another process can load it.
+// It is written to a temporary file and renamed, so readers never see part of it.
+int savenet(const string& f, const BSolu& b)
+{
+	string t = f + ".tmp";
+	ofstream h(t.data());
+	if(!h)
+		return 1;
+	h.precision(17);
+	h << "Score\t" << b.s << endl;
+	for(set<int>::const_iterator i = b.mbnd.begin(); i != b.mbnd.end(); i++)
+		h << "Motif\t" << b.mscor[*i].name << "\t" << b.mscor[*i].didx << endl;
+	for(size_t i = 0; i < b.cons.size(); i++)
+	{
+		const Constraint& c = b.cons[i];
+		h << "Constraint\t" << c.desc << "\t" << b.mscor[c.motif0].name << "\t" 
+			<< ((c.motif1 == -1)? "-" : b.mscor[c.motif1].name) << "\t" << c.para << endl;
+	}
+	h.close();
+	if(!h)
+		return 1;
+	return rename(t.data(), f.data());
+}
+
+// Index of a motif of the calling thread by name; -1 if not found.
+static int motifidx(const string& name)
+{
+	for(size_t i = 0; i < mscor.size(); i++)
+	{
+		if(mscor[i].name == name)
+			return (int)i;
+	}
+	return -1;
+}
+
+// Load a network written by savenet onto the motifs of the calling thread. 
+// CPT is not loaded. Return 1 if it can't be read or has a motif not in the list.
+int loadnet(const string& f, BSolu& b)
+{
+	ifstream h(f.data());
+	if(!h)
+		return 1;
+	b.s = 1;
+	b.cons.clear();
+	b.cpt.clear();
+	b.mbnd.clear();
+	b.mscor = mscor;
+	string strLn;
+	while(getline(h, strLn))
+	{
+		istringstream strmLn(strLn);
+		string tag;
+		strmLn >> tag;
+		if(tag == "Score")
+			strmLn >> b.s;
+		else if(tag == "Motif")
+		{
+			string name;
+			int didx = -1;
+			strmLn >> name >> didx;
+			int mi = motifidx(name);
+			if(mi == -1 || didx < 0 || didx >= nfunc)
+				return 1;
+			b.mscor[mi].didx = didx;
+			b.mbnd.insert(mi);
+		}
+		else if(tag == "Constraint")
+		{
+			Constraint c;
+			string m0, m1;
+			strmLn >> c.desc >> m0 >> m1 >> c.para;
+			c.motif0 = motifidx(m0);
+			c.motif1 = (m1 == "-")? -1 : motifidx(m1);
+			if(c.motif0 == -1 || (m1 != "-" && c.motif1 == -1) || ruleid(c.desc) == -1)
+				return 1;
+			b.cons.push_back(c);
+		}
+	}
+	return (b.s == 1 || b.cons.empty())? 1 : 0;
+}
+
+// Files of networks written by savenet in a folder.
+void netfiles(const string& dir, vector<string>& v)
+{
+	error_code ec;
+	for(filesystem::directory_iterator i(dir, ec); !ec && i != filesystem::directory_iterator(); i.increment(ec))
+	{
+		if(i->path().extension() == ".net")
+			v.push_back(i->path().string());
+	}
+	sort(v.begin(), v.end());
+}
+
+// Island mode: publish the best network and take the best one of other islands 
+// if it is better. Its score is computed again on the genes of this process.
+double migrate(double s, vector<Constraint>& cons, vector<CPTRow>& cpt, const vector<Case>& genlst)
+{
+	string own = isldir + "/" + islname;
+	if(bsolu.s != 1 && savenet(own, bsolu) != 0)
+		cerr << "Can't write " << own << endl;
+	vector<string> v;
+	netfiles(isldir, v);
+	BSolu m;	// best migrant.
+	string mf;
+	for(size_t i = 0; i < v.size(); i++)
+	{
+		BSolu b;
+		if(filesystem::path(v[i]).filename() == islname || loadnet(v[i], b) != 0)
+			continue;
+		if(mf == "" || b.s > m.s)
+		{
+			m = b;
+			mf = v[i];
+		}
 	}
+	if(mf == "" || (bsolu.s != 1 && m.s <= bsolu.s))
+		return s;
+	vector<MotifScore> ms = mscor;
+	mscor = m.mscor;
+	vector<CPTRow> cpt1;
+	double s1 = evalnet(cpt1, genlst, m.cons);
+	if(fabs(s1 - m.s) > 1e-6*fabs(m.s))	// not learned on the same data.
+	{
+		cerr << "Score of " << mf << " is " << s1 << " here, not " << m.s << "; ignored." << endl;
+		mscor = ms;
+		return s;
+	}
+	vout() << "Taking network of " << mf << " with score " << s1 << endl;
+	s = s1;
+	cons = m.cons;
+	cpt = cpt1;
+	mbnd = m.mbnd;
+	netver++;
+	if(tagbests)
+		bestsolu(s, cons, cpt, mbnd, mscor);
 	return s;
 }
 
@@ -1486,70 +3626,81 @@ int outgene(const string& f, const vector<Case>& n, const vector<Case>& b, const
 void outbind(ofstream& h, const string& gene, const vector<Constraint>& cons)
 {
 		h << gene << endl;
+		map<string, int>::const_iterator gi = gidx.find(gene);
+		int g = (gi != gidx.end())? gi->second : -1;
 		for(size_t j = 0; j < cons.size(); j++)
 		{
-			const string& mnam0 = mscor[cons[j].motif0].name;
-			const VGB& m0 = allbind.e[mnam0].e[gene];
-			double depth0 = mscor[cons[j].motif0].depth;
+			BindPtr p0 = getbind(mscor[cons[j].motif0].name);
+			const MotifBind& b0 = *p0;
+			int d0 = mscor[cons[j].motif0].didx;
 			if(cons[j].desc == "pres" || cons[j].desc == "tss" || 
 				cons[j].desc == "orien" || cons[j].desc == "sec")
 			{
-				const VGB& m1 = m0;	// m1 is NULL.
-				double depth1 = -1;	// depth1 is invalid.
-				h << "constraint " << j+1 << "\t" << binds(cons[j], m0, depth0, m1, depth1) << endl;
+				const MotifBind& b1 = b0;	// b1 is NULL.
+				int d1 = -1;	// d1 is invalid.
+				h << "constraint " << j+1 << "\t" << binds(cons[j], b0, d0, b1, d1, g) << endl;
 			}
 			else if(cons[j].desc == "dist" || cons[j].desc == "order")
 			{
-				const string& mnam1 = mscor[cons[j].motif1].name;
-				const VGB& m1 = allbind.e[mnam1].e[gene];
-				double depth1 = mscor[cons[j].motif1].depth;
-				h << "constraint " << j+1 << "\t" << binds(cons[j], m0, depth0, m1, depth1) << endl;
+				BindPtr p1 = getbind(mscor[cons[j].motif1].name);
+				const MotifBind& b1 = *p1;
+				int d1 = mscor[cons[j].motif1].didx;
+				h << "constraint " << j+1 << "\t" << binds(cons[j], b0, d0, b1, d1, g) << endl;
 			}
 		}
 }
 
 // The binding sites that satisfy one constraint.
-string binds(const Constraint& c, const VGB& m0, double d0, const VGB& m1, double d1)
+string binds(const Constraint& c, const MotifBind& b0, int d0, const MotifBind& b1, int d1, int g)
 {
+	if(g < 0 || (size_t)g + 1 >= b0.off.size())
+		return "NONE";
+	int s0 = b0.off[g], e0 = b0.off[g+1];	// range of motif0's sites.
+	int s1 = 0, e1 = 0;	// range of motif1's sites.
+	if((size_t)g + 1 < b1.off.size())
+	{
+		s1 = b1.off[g];
+		e1 = b1.off[g+1];
+	}
 	string info = "";
 	if(c.desc == "pres")
 	{
-		for(size_t i = 0; i < m0.e.size(); i++)
+		for(int i = s0; i < e0; i++)
 		{
-			if(m0.e[i].score >= d0)
-				info += fmtsite(m0.e[i]) + "\t";
+			if((b0.bin[i] & DEPBITS) > d0)
+				info += fmtsite(b0, i) + "\t";
 		}
 	}
 	else if(c.desc == "tss")
 	{
-		for(size_t i = 0; i < m0.e.size(); i++)
+		for(int i = s0; i < e0; i++)
 		{
-			if(m0.e[i].score >= d0 && m0.e[i].loc <= c.para)
-				info += fmtsite(m0.e[i]) + "\t";
+			if((b0.bin[i] & DEPBITS) > d0 && b0.loc[i] <= c.para)
+				info += fmtsite(b0, i) + "\t";
 		}
 	}
 	else if(c.desc == "orien")
 	{
-		for(size_t i = 0; i < m0.e.size(); i++)
+		for(int i = s0; i < e0; i++)
 		{
-			if(m0.e[i].score < d0)
+			if((b0.bin[i] & DEPBITS) <= d0)
 				continue;
-			if(m0.e[i].orien == 'F' && c.para == 0)
-				info += fmtsite(m0.e[i]) + "\t";
-			else if(m0.e[i].orien == 'R' && c.para == 1)
-				info += fmtsite(m0.e[i]) + "\t";
+			if(!(b0.bin[i] & REVBIT) && c.para == 0)
+				info += fmtsite(b0, i) + "\t";
+			else if((b0.bin[i] & REVBIT) && c.para == 1)
+				info += fmtsite(b0, i) + "\t";
 		}
 	}
 	else if(c.desc == "sec")
 	{
 		int count = 0;
 		string info1 = "";
-		for(size_t i = 0; i < m0.e.size(); i++)
+		for(int i = s0; i < e0; i++)
 		{
-			if(m0.e[i].score >= d0)
+			if((b0.bin[i] & DEPBITS) > d0)
 			{
 				count++;
-				info1 += fmtsite(m0.e[i]) + "\t";
+				info1 += fmtsite(b0, i) + "\t";
 			}
 		}
 		if(count > 1)
@@ -1557,48 +3708,48 @@ string binds(const Constraint& c, const VGB& m0, double d0, const VGB& m1, doubl
 	}
 	else if(c.desc == "dist")
 	{
-		for(size_t i = 0; i < m0.e.size(); i++)
+		for(int i = s0; i < e0; i++)
 		{
-			if(m0.e[i].score < d0)
+			if((b0.bin[i] & DEPBITS) <= d0)
 				continue;
-			for(size_t j = 0; j < m1.e.size(); j++)
+			for(int j = s1; j < e1; j++)
 			{
-				if(m1.e[j].score < d1)
+				if((b1.bin[j] & DEPBITS) <= d1)
 					continue;
-				if(abs((m0.e[i].loc - m1.e[j].loc)) <= c.para)
-					info += fmtsite(m0.e[i]) + fmtsite(m1.e[j]) + "\t";
+				if(abs((b0.loc[i] - b1.loc[j])) <= c.para)
+					info += fmtsite(b0, i) + fmtsite(b1, j) + "\t";
 			}
 		}
 	}
 	else if(c.desc == "order")
 	{
-		for(size_t i = 0; i < m0.e.size(); i++)
+		for(int i = s0; i < e0; i++)
 		{
-			if(m0.e[i].score < d0)
+			if((b0.bin[i] & DEPBITS) <= d0)
 				continue;
-			for(size_t j = 0; j < m1.e.size(); j++)
+			for(int j = s1; j < e1; j++)
 			{
-				if(m1.e[j].score < d1)
+				if((b1.bin[j] & DEPBITS) <= d1)
 					continue;
-				if(m0.e[i].loc < m1.e[j].loc && c.para == 0)
-					info += fmtsite(m0.e[i]) + fmtsite(m1.e[j]) + "\t";
-				else if(m0.e[i].loc > m1.e[j].loc && c.para == 1)
-					info += fmtsite(m0.e[i]) + fmtsite(m1.e[j]) + "\t";
+				if(b0.loc[i] < b1.loc[j] && c.para == 0)
+					info += fmtsite(b0, i) + fmtsite(b1, j) + "\t";
+				else if(b0.loc[i] > b1.loc[j] && c.para == 1)
+					info += fmtsite(b0, i) + fmtsite(b1, j) + "\t";
 			}
 		}
 	}
 	else if(c.desc == "loop")
 	{
-		for(size_t i = 0; i < m0.e.size(); i++)
+		for(int i = s0; i < e0; i++)
 		{
-			if(m0.e[i].score < d0)
+			if((b0.bin[i] & DEPBITS) <= d0)
 				continue;
-			for(size_t j = 0; j < m1.e.size(); j++)
+			for(int j = s1; j < e1; j++)
 			{
-				if(m1.e[j].score < d1)
+				if((b1.bin[j] & DEPBITS) <= d1)
 					continue;
-				if(abs((m0.e[i].loc - m1.e[j].loc)) > c.para)
-					info += fmtsite(m0.e[i]) + fmtsite(m1.e[j]) + "\t";
+				if(abs((b0.loc[i] - b1.loc[j])) > c.para)
+					info += fmtsite(b0, i) + fmtsite(b1, j) + "\t";
 			}
 		}
 	}
@@ -1611,13 +3762,17 @@ string binds(const Constraint& c, const VGB& m0, double d0, const VGB& m1, doubl
 }
 
 // Format a string describing a binding site.
-string fmtsite(const GBinding& gb, bool parth)
+// Matrix score is reported as the highest functional depth it reaches.
+string fmtsite(const MotifBind& b, int k, bool parth)
 {
+	char orien = (b.bin[k] & REVBIT)? 'R' : 'F';
+	int db = b.bin[k] & DEPBITS;
+	double score = (db > 0)? func_depths[db-1] : 0.0;
 	ostringstream strm;
 	if(parth)
-		strm << "(" << gb.orien << "," << gb.score << "," << gb.loc << ")";
+		strm << "(" << orien << "," << score << "," << b.loc[k] << ")";
 	else
-		strm << gb.orien << "," << gb.score << "," << gb.loc;
+		strm << orien << "," << score << "," << b.loc[k];
 	return strm.str();
 }
 
@@ -1654,8 +3809,9 @@ inline void bestsolu(double s, const vector<Constraint>& cons, const vector<CPTR
 		bsolu.cpt = cpt;
 		bsolu.mbnd = mbnd;
 		bsolu.mscor = mscor;
+		snapshot(s, cons, cpt);
 #ifdef VERBOSE
-		cout << "Best solution updated!" << endl;
+		vout() << "Best solution updated!" << endl;
 #endif
 	}
 }
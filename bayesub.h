@@ -22,12 +22,25 @@ double bbnet(vector<Constraint>& cons, vector<CPTRow>& cpt, const vector<Case>&
 // Learn Bayesian network - GBNet.
 double gbnet(vector<Constraint>& cons, vector<CPTRow>& cpt, const vector<Case>& genlst);
 
+// Learn Bayesian network - exact search.
+double bbexact(vector<Constraint>& cons, vector<CPTRow>& cpt, const vector<Case>& genlst);
+
+// Learn Bayesian network - beam search.
+double bmnet(vector<Constraint>& cons, vector<CPTRow>& cpt, const vector<Case>& genlst);
+
+// Learn Bayesian network - tabu search.
+double tbnet(vector<Constraint>& cons, vector<CPTRow>& cpt, const vector<Case>& genlst);
+
+// A learning engine: bbnet, gbnet, bbexact, bmnet or tbnet.
+typedef double (*BNEngine)(vector<Constraint>& cons, vector<CPTRow>& cpt, const vector<Case>& genlst);
+
 // According to a set of constraints, classify a gene into a category. 
 // Different combinations of the constraints are described in the bits of an integer.
 int classification(const string& gene, const vector<Constraint>& cons);
+int classification(int g, const vector<Constraint>& cons);	// Overloading for gene index.
 
 // Test whether a gene satisfies one constraint.
-int test(const Constraint& c, const VGB& m0, double d0, const VGB& m1, double d1, int tss = 0);
+int test(const Constraint& c, const MotifBind& b0, int d0, const MotifBind& b1, int d1, int g, int tss = 0);
 
 // Calculate Bayesian score given CPT and priors.
 double score(int np, const vector<CPTRow>& cpt, const vector<CPTRow>& ppt);
@@ -44,12 +57,18 @@ int loadgene(vector<Case>& tlst, vector<Case>& blst, const string& n, const stri
 // Load motif list from file.
 int loadmotif(vector<string>& motiflst, const string& f);
 
+// Index all genes whose binding will be loaded.
+int mkgidx(const set<string>& genset);
+
+// Set index in binding for each case.
+void setgidx(vector<Case>& genlst);
+
 // Load one motif's binding.
-int loadone(GBMap& onebind, const string& motif, const set<string>& genset, const string& folder);
+int loadone(MotifBind& onebind, const string& motif, const string& folder);
 
 // Load all motifs' binding.
-int loadbind(MotifMap& allbind, const vector<string>& motiflst, const set<string>& genset, const string& folder);
-int loadbind(MotifMap& allbind, const vector<MotifScore>& mscor, const set<string>& genset, const string& folder); // Overloading.
+int loadbind(MotifMap& allbind, const vector<string>& motiflst, const string& folder);
+int loadbind(MotifMap& allbind, const vector<MotifScore>& mscor, const string& folder); // Overloading.
 
 // Comparing routine for sorting motif scores.
 bool cmp(MotifScore s0, MotifScore s1);
@@ -57,11 +76,41 @@ bool cmp(MotifScore s0, MotifScore s1);
 // Display the candidate motifs and their scores.
 void dispscor(const vector<MotifScore>& mscor);
 
+// Genes in the index that satisfy one constraint at the current depths.
+ConsBits consbits(const Constraint& c);
+
 // Construct conditional probability table given gene list, constraints and motif binding.
 void constrcpt(vector<CPTRow>& cpt, vector<CPTRow>& ppt, const vector<Case>& genlst, const vector<Constraint>& cons);
 
+// Check that binding files of all motifs can be opened.
+int chkbind(const vector<MotifScore>& mscor, const string& folder);
+
+// Binding of one motif, loaded from "bfolder" on first use.
+BindPtr getbind(const string& motif);
+
+// Memory occupied by one motif's binding in bytes.
+size_t bindsize(const MotifBind& b);
+
+// Settings of the calling thread.
+RunConf getconf();
+
+// Apply settings to the calling thread, such as a worker of parfor.
+void setconf(const RunConf& c);
+
+// Output the best score over time of the last beam or tabu search of the calling thread.
+void outtrace(ofstream& h);
+
+// Output counters of binding and constraint cache, network table and exact search.
+void outcache(ofstream& h);
+
+// Load a motif's binding in background.
+void prefetch(const string& motif);
+
+// Wait for background loading to finish.
+void waitfetch();
+
 // Extract binding of a site from a string.
-GBinding extrbnd(const string& s);
+void extrbnd(const char* s, const char* e, unsigned char& bin, int& loc);
 
 // Transform a string to upper case.
 string& str2upper(string& str);
@@ -73,6 +122,9 @@ double logamma(int x);
 double addcons(vector<Constraint>& cons, vector<CPTRow>& cpt, Constraint c, double s, 
 			   const vector<Case>& genlst, const int paraset[], int npara, bool jump = false);
 
+// Propose one random change of the network and accept it by Metropolis-Hastings.
+double mhstep(vector<Constraint>& cons, vector<CPTRow>& cpt, double s, const vector<Case>& genlst);
+
 // Delete constraint to improve score.
 double delcons(vector<Constraint>& cons, vector<CPTRow>& cpt, double s, const vector<Case>& genlst);
 
@@ -100,15 +152,45 @@ void outscor(ofstream& h, const vector<MotifScore>& mscor);
 // Find the index in depth array according to the depth.
 int depidx(double depth);
 
+// Number of functional depths that are not above a matrix score.
+int depbin(double score);
+
+// Translational(transcriptional) start site of a gene.
+int tsspos(int g);
+
 // Add prior information into CPT.
 void setprior(vector<CPTRow>& ppt, const vector<Constraint>& cons);
 
+// Score a network, taking its CPT from the table of visited networks if possible.
+double evalnet(vector<CPTRow>& cpt, const vector<Case>& genlst, const vector<Constraint>& cons);
+
+// Presence score of one motif on a gene list at its best functional depth.
+MotifScore presscor(const string& motif, const vector<Case>& genlst);
+
+// Presence scores of motifs streamed through the thread pool; return 1 if a binding file can't be read.
+int streamscor(vector<MotifScore>& vscor, const vector<string>& motiflst, const vector<Case>& genlst);
+
+// Top "ntop" motif pairs by joint presence, and by distance and order if "tagpos"; return 1 if a binding file can't be read.
+int pairscor(vector<PairScore>& vps, const vector<string>& motiflst, const vector<Case>& genlst, size_t ntop, bool tagpos);
+
+// Comparing routine for sorting motif pair scores.
+bool pcmp(const PairScore& s0, const PairScore& s1);
+
 // Initialize CPT.
 void initcpt(vector<CPTRow>& cpt, size_t ns, int val = 0);
 
 // The number of genes that satisfy each constraint from CPT.
 vector<CPTRow> ebitcpt(const vector<CPTRow>& cpt, size_t nc);
 
+// Seed random numbers of the calling thread.
+void setseed(unsigned int seed);
+
+// Uniform random number in [0, 1) from the calling thread's generator.
+double unirand();
+
+// Reset search state of the calling thread before learning a network.
+void initrun(const vector<MotifScore>& vms);
+
 // Take a bootstrap sample for a vector of objects.
 vector<Case> bsamp(const vector<Case>& t, const vector<Case>& b);
 
@@ -139,6 +221,31 @@ inline void bestsolu(double s, const vector<Constraint>& cons, const vector<CPTR
 // Restart SA with best solution if bad condition happens.
 double restart(double s, vector<Constraint>& cons, vector<CPTRow>& cpt, int& iter);
 
+// Start the clock of "timelimit" and stop searches on SIGTERM.
+void setdeadline();
+
+// Whether a search should stop now: past the time limit or SIGTERM received.
+bool timeup();
+
+// Rewrite file f with the best network of the search in the calling thread.
+void setsnap(const string& f, const vector<MotifScore>& vms, size_t node, size_t bkg);
+
+// Write the network to the file of setsnap if it is better than the last one written.
+void snapshot(double s, const vector<Constraint>& cons, const vector<CPTRow>& cpt);
+
+// Write a network with motif names and depths so that another process can load it.
+int savenet(const string& f, const BSolu& b);
+
+// Load a network written by savenet onto the motifs of the calling thread. 
+// CPT is not loaded. Return 1 if it can't be read or has a motif not in the list.
+int loadnet(const string& f, BSolu& b);
+
+// Files of networks written by savenet in a folder.
+void netfiles(const string& dir, vector<string>& v);
+
+// Island mode: publish the best network and take the best one of other islands if better.
+double migrate(double s, vector<Constraint>& cons, vector<CPTRow>& cpt, const vector<Case>& genlst);
+
 
 // Calculate P-value based on Fisher's exact test.
 double fpval(double nm, double nn, double bm, double bn);
@@ -150,10 +257,10 @@ int outgene(const string& f, const vector<Case>& n, const vector<Case>& b, const
 void outbind(ofstream& h, const string& gene, const vector<Constraint>& cons);
 
 // The binding sites that satisfy one constraint.
-string binds(const Constraint& c, const VGB& m0, double d0, const VGB& m1, double d1);
+string binds(const Constraint& c, const MotifBind& b0, int d0, const MotifBind& b1, int d1, int g);
 
 // Format a string describing a binding site.
-string fmtsite(const GBinding& gb, bool parth = true);
+string fmtsite(const MotifBind& b, int k, bool parth = true);
 
 // Load translationl/transcriptional start sites.
 int loadtss(const string& f, map<string, int>& m);
@@ -15,6 +15,8 @@
 #include "bayesub.h"
 #include "globals.h"
 #include "CmdLine.h"
+#include "thrpool.h"
+#include "multirun.h"
 
 
 int main(int argc, char* argv[])
@@ -22,7 +24,7 @@ int main(int argc, char* argv[])
 	// Read parameters from console.
 	CCmdLine cmdLine;
 
-	if(cmdLine.SplitLine(argc, argv) < 5)
+	if(cmdLine.SplitLine(argc, argv) < 4)
 	{
 		cerr << "Usage: ./bbnet -s score_file -n node -b bkg -f func_depth -o output" << endl;
 		cerr << endl << "Additional parameter:" << endl;
@@ -32,6 +34,21 @@ int main(int argc, char* argv[])
 		cerr << "-l\toutput of all training samples' information." << endl;
 		cerr << "-t\ttranslational(transcriptional) start sites.(Default = right end)" << endl;
 		cerr << "-rb\tbit-string to determine which rules to include.(Default = 111110)" << endl;
+		cerr << "-cv\tK-fold cross validation in memory, output each held-out gene's probability with -bp" << endl;
+		cerr << "-bootstrap\tNumber of bootstrap replicates learned in memory" << endl;
+		cerr << "-perm\tNumber of label permutations learned in memory to test the score" << endl;
+		cerr << "-k-sweep\tComma separated logK values learned in memory, e.g. 5.0,6.5,8.0" << endl;
+		cerr << "-clusters\tFolder of cluster lists(BGNnh.txt), learn each cluster against the rest instead of -n and -b" << endl;
+		cerr << "-exact\tExact search from bbnet's network: max networks visited and seconds(Default = 10000000 600)" << endl;
+		cerr << "-beam\tBeam search keeping this many networks at each step(Default = 5)" << endl;
+		cerr << "-tabu\tTabu search: steps a reversed move is tabu and steps without a better network to stop(Default = 5 20)" << endl;
+		cerr << "-j\tNumber of threads for parallel runs(Default = all cores)" << endl;
+		cerr << "-seed\tSeed of random numbers(Default = 1)" << endl;
+		cerr << "-time-limit\tSeconds to stop the search and output its best network, which is also written to output whenever it improves(Default = no limit)" << endl;
+		cerr << "-pf\tLoad the next candidate motif's binding in background" << endl;
+		cerr << "-mem\tMemory cap of motif binding in MB, least recently used motifs are reloaded when needed.(Default = no cap)" << endl;
+		cerr << "-cmem\tMemory cap of cached constraint bitmaps in MB.(Default = 64)" << endl;
+		cerr << "-tt\tNetworks kept in the score table of each run, 0 to turn off.(Default = 65536)" << endl;
 		cerr << "-i\tUse mutual information instead of Bayesian score" << endl;
 		cerr << endl << "Contact: \"Li Shen\"<shen@ucsd.edu>" << endl;
 		return 1;
@@ -41,8 +58,11 @@ int main(int argc, char* argv[])
 	try
 	{
 		s = cmdLine.GetArgument("-s", 0);	// score file.
-		n = cmdLine.GetArgument("-n", 0);	// node gene list file.
-		b = cmdLine.GetArgument("-b", 0);	// bkg gene list file.
+		if(!cmdLine.HasSwitch("-clusters"))
+		{
+			n = cmdLine.GetArgument("-n", 0);	// node gene list file.
+			b = cmdLine.GetArgument("-b", 0);	// bkg gene list file.
+		}
 		f = cmdLine.GetArgument("-f", 0);	// func depth folder.
 		o = cmdLine.GetArgument("-o", 0);	// results output file.
 	}
@@ -118,7 +138,99 @@ int main(int argc, char* argv[])
 	rb = cmdLine.GetSafeArgument("-rb", 0, "111110");
 
 	string bp = cmdLine.GetSafeArgument("-bp", 0, "");	// Output each gene's probability like in Beer's prediction.
+
+	string cv = cmdLine.GetSafeArgument("-cv", 0, "0");	// number of folds for cross validation in memory.
+	int cvk = atoi(cv.data());
+	string bs = cmdLine.GetSafeArgument("-bootstrap", 0, "0");	// number of bootstrap replicates in memory.
+	int bsn = atoi(bs.data());
+	string pm = cmdLine.GetSafeArgument("-perm", 0, "0");	// number of label permutations in memory.
+	int pmn = atoi(pm.data());
+	string ksw = cmdLine.GetSafeArgument("-k-sweep", 0, "");	// logK values to sweep in memory.
+	string sd = cmdLine.GetSafeArgument("-seed", 0, "1");	// seed of random numbers.
+	unsigned int seed = (unsigned int)atoi(sd.data());
+	setseed(seed);
+	BNEngine engine = bbnet;
+	if(cmdLine.HasSwitch("-exact"))	// exact search with a budget of networks and seconds.
+	{
+		engine = bbexact;
+		string en = cmdLine.GetSafeArgument("-exact", 0, "");	// empty if -exact has no value.
+		if(en != "")
+			exbudget = atol(en.data());
+		string es = cmdLine.GetSafeArgument("-exact", 1, "");
+		if(es != "")
+			exsecs = atof(es.data());
+	}
+	if(cmdLine.HasSwitch("-beam"))	// beam search with a width.
+	{
+		engine = bmnet;
+		string bw = cmdLine.GetSafeArgument("-beam", 0, "");
+		if(bw != "")
+			beamw = atoi(bw.data());
+	}
+	if(cmdLine.HasSwitch("-tabu"))	// tabu search with a tenure and steps to stop.
+	{
+		engine = tbnet;
+		string tn = cmdLine.GetSafeArgument("-tabu", 0, "");
+		if(tn != "")
+			tabutn = atoi(tn.data());
+		string ts = cmdLine.GetSafeArgument("-tabu", 1, "");
+		if(ts != "")
+			tabustep = atoi(ts.data());
+	}
+	string j = cmdLine.GetSafeArgument("-j", 0, "0");	// number of threads.
+	nthread = atoi(j.data());
+	string tl = cmdLine.GetSafeArgument("-time-limit", 0, "0");	// seconds of anytime search.
+	timelimit = atof(tl.data());
+	setdeadline();	// a killed job still ends with its best network.
 	
+	if(cmdLine.HasSwitch("-pf"))
+		fetchtag = true;
+	string mem = cmdLine.GetSafeArgument("-mem", 0, "0");	// memory cap of binding in MB.
+	bndcap = (size_t)(atof(mem.data())*1048576);
+	string cmem = cmdLine.GetSafeArgument("-cmem", 0, "64");	// memory cap of constraint bitmaps in MB.
+	conscap = (size_t)(atof(cmem.data())*1048576);
+	string tt = cmdLine.GetSafeArgument("-tt", 0, "65536");	// networks kept in the score table.
+	netcap = (size_t)atoi(tt.data());
+
+	string cl = cmdLine.GetSafeArgument("-clusters", 0, "");	// folder of clusters for one-vs-rest.
+	if(cl != "")	// Candidates of each cluster are ranked from all motifs of the score file.
+	{
+		vector<string> motiflst, names;
+		vector<vector<string> > clus;
+		if(loadmotif(motiflst, s) != 0 || loadclus(cl, names, clus) != 0)
+		{
+			cerr << "Load motifs or clusters error!" << endl;
+			return 1;
+		}
+		set<string> genset;
+		for(size_t i = 0; i < clus.size(); i++)
+			genset.insert(clus[i].begin(), clus[i].end());
+		mkgidx(genset);
+		bfolder = f;
+		vector<MotifScore> vms(motiflst.size());
+		for(size_t i = 0; i < motiflst.size(); i++)
+			vms[i].name = motiflst[i];
+		if(chkbind(vms, f) != 0)
+		{
+			cerr << "Load binding information error!" << endl;
+			return 1;
+		}
+		ofstream hOut(o.data());
+		if(!hOut)
+		{
+			cerr << "Can't open " << o << endl;
+			return 1;
+		}
+		if(clusrun(hOut, o, engine, names, clus, motiflst, seed) != 0)
+		{
+			cerr << "One-vs-rest learning error!" << endl;
+			return 1;
+		}
+		outcache(hOut);
+		hOut.close();
+		return 0;
+	}
+
 	// Load motif Bayesian score file.
 	if(loadscor(mscor, s) != 0)
 	{
@@ -160,18 +272,17 @@ int main(int argc, char* argv[])
 			genset.insert(rlst[i]);
 	}
 
-	// Load motif binding information of genes in genmap.
-	if(loadbind(allbind, mscor, genset, f) != 0)
+	// Motif binding of genes in genset is loaded on first use.
+	mkgidx(genset);
+	setgidx(tlst);
+	setgidx(blst);
+	setgidx(genlst);
+	bfolder = f;
+	if(chkbind(mscor, f) != 0)
 	{
 		cerr << "Load binding information error!" << endl;
 		return 1;
 	}
-	else
-	{
-#ifdef VERBOSE
-		cout << "Load binding information completed!" << endl;
-#endif
-	}
 
 	// File for output.
 	ofstream hOut(o.data());
@@ -183,14 +294,82 @@ int main(int argc, char* argv[])
 	hOut << "Number of genes in category 1: " << tlst.size() << endl;
 	hOut << "Number of genes in category 0: " << blst.size() << endl << endl;
 
+	if(cvk > 0)	// Cross validation replaces learning on all genes.
+	{
+		ofstream hbp;
+		if(bp != "")
+		{
+			hbp.open(bp.data());
+			if(!hbp)
+			{
+				cerr << "Can't open " << bp << endl;
+				return 1;
+			}
+		}
+		if(cvrun(hOut, (bp != "")? &hbp : NULL, engine, tlst, blst, cvk, oscor, seed) != 0)
+		{
+			cerr << "Cross validation error!" << endl;
+			return 1;
+		}
+		outcache(hOut);
+		hOut.close();
+		return 0;
+	}
+	if(bsn > 0)	// Bootstrap replicates replace learning on all genes.
+	{
+		if(bootrun(hOut, engine, tlst, blst, bsn, oscor, seed) != 0)
+		{
+			cerr << "Bootstrap error!" << endl;
+			return 1;
+		}
+		outcache(hOut);
+		hOut.close();
+		return 0;
+	}
+	if(ksw != "")	// One network for each logK value.
+	{
+		vector<string> ks;
+		istringstream strmK(ksw);
+		string k1;
+		while(getline(strmK, k1, ','))
+		{
+			if(k1 != "")
+				ks.push_back(k1);
+		}
+		if(sweeprun(hOut, o, engine, tlst, blst, ks, oscor, seed, plst, nlst) != 0)
+		{
+			cerr << "logK sweep error!" << endl;
+			return 1;
+		}
+		outcache(hOut);
+		hOut.close();
+		return 0;
+	}
+	if(pmn > 0)	// Learning on all genes is followed by permutations.
+	{
+		if(permrun(hOut, engine, tlst, blst, pmn, oscor, seed) != 0)
+		{
+			cerr << "Permutation test error!" << endl;
+			return 1;
+		}
+		outcache(hOut);
+		hOut.close();
+		return 0;
+	}
+
 #ifdef VERBOSE
 	cout << endl << "Running on original data." << endl;
 #endif
 	vector<Constraint> cons;
 	vector<CPTRow> cpt;
 	clock_t start = clock();
-	double scor = bbnet(cons, cpt, genlst);
+	setsnap(o, oscor, tlst.size(), blst.size());
+	double scor = engine(cons, cpt, genlst);
 	clock_t finish = clock();
+	hOut.close();	// snapshots may have replaced the output file, so it is written again.
+	hOut.open(o.data());
+	hOut << "Number of genes in category 1: " << tlst.size() << endl;
+	hOut << "Number of genes in category 0: " << blst.size() << endl << endl;
 	if(outbayes(hOut, scor, cons, cpt, oscor, tlst.size(), blst.size()) != 0)
 	{
 		cerr << "Output Bayesian network results error!" << endl;
@@ -229,7 +408,11 @@ int main(int argc, char* argv[])
 			hbp.close();
 		}
 	}
+	if(timeup())
+		hOut << endl << "Search stopped at the time limit or on SIGTERM." << endl;
 	hOut << endl << "Bayesian network occupied CPU " << (double)(finish-start)/CLOCKS_PER_SEC << " seconds." << endl;
+	outtrace(hOut);
+	outcache(hOut);
 	hOut.close();
 
 	return 0;
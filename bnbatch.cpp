@@ -0,0 +1,284 @@
+/*	bnbatch.cpp
+
+	Main routine of batch Bayesian network learning.
+	1. Load the job manifest and each distinct data set once.
+	2. Run all jobs on the thread pool.
+	3. Output each job's network and a summary of all jobs.
+*/
+
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <sstream>
+#include <chrono>
+#include <exception>
+#include "bayesub.h"
+#include "globals.h"
+#include "sa.h"
+#include "CmdLine.h"
+#include "thrpool.h"
+#include "multirun.h"
+
+// One line of the manifest.
+typedef struct{
+	string name;	// output file of the job.
+	string engine;	// bb, gb, ex, bm or tb.
+	string s, n, b;	// score file, node and bkg lists.
+	RunConf conf;
+	unsigned int seed;
+	string err;	// reason of failure; empty if none.
+	double scor;
+	size_t ncons;
+	double sec;
+} BatchJob;
+
+// Load the manifest: one job per line, lines starting with '#' are skipped.
+// name engine score_file node bkg [logK rb seed repeats iterations changes alpha initemp]
+int loadjobs(vector<BatchJob>& jobs, const string& f)
+{
+	ifstream h(f.data());
+	if(!h)
+	{
+		cerr << "Can't open " << f << endl;
+		return 1;
+	}
+	while(h.good())
+	{
+		string strLn;
+		getline(h, strLn);
+		if(strLn == "" || strLn[0] == '#')
+			continue;
+		istringstream strmLn(strLn);
+		BatchJob jb;
+		strmLn >> jb.name >> jb.engine >> jb.s >> jb.n >> jb.b;
+		if(jb.b == "")
+		{
+			cerr << "Too few fields in manifest line: " << strLn << endl;
+			return 1;
+		}
+		jb.conf.logK = 5.0;
+		jb.conf.rb = "111110";
+		jb.seed = 1;
+		jb.conf.Repeat = 20;	// simulated annealing as gbnet's default.
+		jb.conf.Iteration = 20;
+		jb.conf.Changes = 500;
+		jb.conf.Alpha = 0.9;
+		jb.conf.Initemp = 5.0;
+		strmLn >> jb.conf.logK >> jb.conf.rb >> jb.seed >> jb.conf.Repeat >> jb.conf.Iteration
+			>> jb.conf.Changes >> jb.conf.Alpha >> jb.conf.Initemp;
+		jb.conf.DeterScor = jb.conf.logK;
+		jb.conf.tagbests = (jb.engine == "gb");
+		jb.scor = 0;
+		jb.ncons = 0;
+		jb.sec = 0;
+		if(jb.engine != "bb" && jb.engine != "gb" && jb.engine != "ex" && jb.engine != "bm" && jb.engine != "tb")
+			jb.err = "unknown engine " + jb.engine;
+		else if(jb.conf.rb.size() != 6)
+			jb.err = "rule bit-string must have 6 bits";
+		else if(jb.engine == "gb" && jb.conf.Changes <= Resthrld)
+			jb.err = "max changes must be larger than threshold for restart";
+		jobs.push_back(jb);
+	}
+	h.close();
+
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	// Read parameters from console.
+	CCmdLine cmdLine;
+
+	if(cmdLine.SplitLine(argc, argv) < 3)
+	{
+		cerr << "Usage: ./bnbatch -m manifest -f func_depth -o summary" << endl;
+		cerr << endl << "Each line of the manifest is one job:" << endl;
+		cerr << "name engine(bb/gb/ex/bm/tb) score_file node bkg [logK rb seed repeats iterations changes alpha initemp]" << endl;
+		cerr << "Defaults: 5.0 111110 1 20 20 500 0.9 5.0; the network of a job is written to file name." << endl;
+		cerr << endl << "Additional parameter:" << endl;
+		cerr << "-c\tnumber of candidate motifs (Default=50)" << endl;
+		cerr << "-t\ttranslational(transcriptional) start sites.(Default = right end)" << endl;
+		cerr << "-j\tNumber of threads for parallel jobs(Default = all cores)" << endl;
+		cerr << "-pf\tLoad the next candidate motif's binding in background" << endl;
+		cerr << "-mem\tMemory cap of motif binding in MB, least recently used motifs are reloaded when needed.(Default = no cap)" << endl;
+		cerr << "-cmem\tMemory cap of cached constraint bitmaps in MB.(Default = 64)" << endl;
+		cerr << "-tt\tNetworks kept in the score table of each run, 0 to turn off.(Default = 65536)" << endl;
+		cerr << "-i\tUse mutual information instead of Bayesian score" << endl;
+		cerr << endl << "Contact: \"Li Shen\"<shen@ucsd.edu>" << endl;
+		return 1;
+	}
+
+	string m, f, o;
+	try
+	{
+		m = cmdLine.GetArgument("-m", 0);	// job manifest.
+		f = cmdLine.GetArgument("-f", 0);	// func depth folder.
+		o = cmdLine.GetArgument("-o", 0);	// summary output file.
+	}
+	catch(int)
+	{
+		cerr << "Wrong arguments!" << endl;
+		return 1;
+	}
+
+	if(cmdLine.HasSwitch("-i"))
+		itag = true;
+	string c = cmdLine.GetSafeArgument("-c", 0, "50");	// number of candidate motifs.
+	motifcand = atoi(c.data());
+	string ftss = cmdLine.GetSafeArgument("-t", 0, "");
+	if(ftss != "")
+		loadtss(ftss, mtss);
+	string j = cmdLine.GetSafeArgument("-j", 0, "0");	// number of threads.
+	nthread = atoi(j.data());
+	if(cmdLine.HasSwitch("-pf"))
+		fetchtag = true;
+	string mem = cmdLine.GetSafeArgument("-mem", 0, "0");	// memory cap of binding in MB.
+	bndcap = (size_t)(atof(mem.data())*1048576);
+	string cmem = cmdLine.GetSafeArgument("-cmem", 0, "64");	// memory cap of constraint bitmaps in MB.
+	conscap = (size_t)(atof(cmem.data())*1048576);
+	string tt = cmdLine.GetSafeArgument("-tt", 0, "65536");	// networks kept in the score table.
+	netcap = (size_t)atoi(tt.data());
+
+	vector<BatchJob> jobs;
+	if(loadjobs(jobs, m) != 0)
+	{
+		cerr << "Load manifest error!" << endl;
+		return 1;
+	}
+
+	// Each distinct score file and pair of gene lists is loaded once.
+	map<string, vector<MotifScore> > scors;
+	map<string, vector<Case> > tlsts, blsts;	// keyed by "node\tbkg".
+	set<string> genset;
+	set<string> motifs;
+	for(size_t i = 0; i < jobs.size(); i++)
+	{
+		BatchJob& jb = jobs[i];
+		if(jb.err != "")
+			continue;
+		if(scors.find(jb.s) == scors.end())
+		{
+			vector<MotifScore> vms;
+			if(loadscor(vms, jb.s) == 0)
+			{
+				for(size_t k = 0; k < vms.size(); k++)
+					motifs.insert(vms[k].name);
+			}
+			else
+				vms.clear();
+			scors[jb.s] = vms;
+		}
+		if(scors[jb.s].empty())
+		{
+			jb.err = "can't load score file " + jb.s;
+			continue;
+		}
+		string gk = jb.n + "\t" + jb.b;
+		if(tlsts.find(gk) == tlsts.end())
+		{
+			vector<Case> tlst, blst;
+			if(loadgene(tlst, blst, jb.n, jb.b) != 0)
+				tlst.clear();
+			for(size_t k = 0; k < tlst.size(); k++)
+				genset.insert(tlst[k].name);
+			for(size_t k = 0; k < blst.size(); k++)
+				genset.insert(blst[k].name);
+			tlsts[gk] = tlst;
+			blsts[gk] = blst;
+		}
+		if(tlsts[gk].empty())
+			jb.err = "can't load gene lists " + jb.n + " and " + jb.b;
+	}
+
+	// Motif binding of genes in all lists is loaded on first use.
+	mkgidx(genset);
+	for(map<string, vector<Case> >::iterator i = tlsts.begin(); i != tlsts.end(); i++)
+		setgidx(i->second);
+	for(map<string, vector<Case> >::iterator i = blsts.begin(); i != blsts.end(); i++)
+		setgidx(i->second);
+	bfolder = f;
+	vector<MotifScore> allmot(motifs.size());
+	size_t k = 0;
+	for(set<string>::const_iterator i = motifs.begin(); i != motifs.end(); i++)
+		allmot[k++].name = *i;
+	if(chkbind(allmot, f) != 0)
+	{
+		cerr << "Load binding information error!" << endl;
+		return 1;
+	}
+
+	ofstream hOut(o.data());
+	if(!hOut)
+	{
+		cerr << "Can't open " << o << endl;
+		return 1;
+	}
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	parfor((int)jobs.size(), [&](int i)
+	{
+		BatchJob& jb = jobs[i];
+		if(jb.err != "")
+			return;
+		chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+		try
+		{
+			setconf(jb.conf);
+			const vector<MotifScore>& vms = scors.find(jb.s)->second;
+			const vector<Case>& tlst = tlsts.find(jb.n + "\t" + jb.b)->second;
+			const vector<Case>& blst = blsts.find(jb.n + "\t" + jb.b)->second;
+			vector<Case> genlst = tlst;
+			genlst.insert(genlst.end(), blst.begin(), blst.end());
+			BNEngine engine = bbnet;
+			if(jb.engine == "gb")
+				engine = gbnet;
+			else if(jb.engine == "ex")
+				engine = bbexact;
+			else if(jb.engine == "bm")
+				engine = bmnet;
+			else if(jb.engine == "tb")
+				engine = tbnet;
+			BSolu r = learnrun(engine, genlst, vms, jb.seed);
+			jb.scor = r.s;
+			jb.ncons = r.cons.size();
+
+			ofstream h(jb.name.data());
+			if(!h)
+				jb.err = "can't open " + jb.name;
+			else
+			{
+				h << "Number of genes in category 1: " << tlst.size() << endl;
+				h << "Number of genes in category 0: " << blst.size() << endl << endl;
+				if(outbayes(h, r.s, r.cons, r.cpt, vms, tlst.size(), blst.size()) != 0)
+					jb.err = "output Bayesian network results error";
+				h.close();
+			}
+		}
+		catch(exception& e)
+		{
+			jb.err = e.what();
+		}
+		jb.sec = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+	});
+	double tot = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	int nfail = 0;
+	hOut << "Job\tStatus\tScore\tConstraints\tSeconds" << endl;
+	for(size_t i = 0; i < jobs.size(); i++)
+	{
+		const BatchJob& jb = jobs[i];
+		if(jb.err == "")
+			hOut << jb.name << "\tok\t" << jb.scor << "\t" << jb.ncons << "\t" << jb.sec << endl;
+		else
+		{
+			hOut << jb.name << "\tfailed: " << jb.err << "\t\t\t" << jb.sec << endl;
+			nfail++;
+		}
+	}
+	hOut << endl << "Jobs: " << jobs.size() << "\tFailed: " << nfail << "\tSeconds: " << tot << endl;
+	outcache(hOut);
+	hOut.close();
+
+	return (nfail > 0)? 1 : 0;
+}
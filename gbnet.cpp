@@ -21,6 +21,8 @@
 #include "globals.h"
 #include "sa.h"
 #include "CmdLine.h"
+#include "thrpool.h"
+#include "multirun.h"
 
 
 int main(int argc, char* argv[])
@@ -31,17 +33,34 @@ int main(int argc, char* argv[])
 	// Read in parameters from command line.
 	CCmdLine cmdLine;
 
-	if(cmdLine.SplitLine(argc, argv) < 5)
+	if(cmdLine.SplitLine(argc, argv) < 4)
 	{
 		cerr << "Usage: ./gbnet -s score_file -n node -b bkg -f func_depth -o output" << endl;
 		cerr << endl << "Additional parameters:" << endl;
 		cerr << "-k\tPenalty parameter(logK, Default = 5.0)" << endl;
 		cerr << "-c\tnumber of candidiate motifs" << endl;
 		cerr << "-sa\trepeats iterations max_changes alpha init_temperature" << endl;
+		cerr << "-mh\tPropose random moves accepted by Metropolis-Hastings, number in each iteration(Default = 100)" << endl;
+		cerr << "-asa\tAdaptive schedule: target acceptance of worse networks and evaluations without a better one to stop(Default = 0.1 50000)" << endl;
 		cerr << "-d\tpositive negative (for prediction)" << endl;
 		cerr << "-l\toutput of all training samples' information." << endl;
 		cerr << "-t\ttranslational(transcriptional) start sites.(Default = right end)" << endl;
 		cerr << "-rb\tbit-string to determine which rules to include.(Default = 111110)" << endl;
+		cerr << "-cv\tK-fold cross validation in memory, output each held-out gene's probability with -bp" << endl;
+		cerr << "-bootstrap\tNumber of bootstrap replicates learned in memory" << endl;
+		cerr << "-perm\tNumber of label permutations learned in memory to test the score" << endl;
+		cerr << "-k-sweep\tComma separated logK values learned in memory, e.g. 5.0,6.5,8.0" << endl;
+		cerr << "-clusters\tFolder of cluster lists(BGNnh.txt), learn each cluster against the rest instead of -n and -b" << endl;
+		cerr << "-chains\tPosterior sampling by MH moves: chains burn-in samples temperature(Default = 4 1000 10000 1.0)" << endl;
+		cerr << "-island\tShared folder of island mode and repeats between migrations(Default = off; 1)" << endl;
+		cerr << "-merge\tOutput the best network published in a shared folder of island mode" << endl;
+		cerr << "-j\tNumber of threads for parallel runs(Default = all cores)" << endl;
+		cerr << "-seed\tSeed of random numbers(Default = 1)" << endl;
+		cerr << "-time-limit\tSeconds to stop the search and output its best network, which is also written to output whenever it improves(Default = no limit)" << endl;
+		cerr << "-pf\tLoad the next candidate motif's binding in background" << endl;
+		cerr << "-mem\tMemory cap of motif binding in MB, least recently used motifs are reloaded when needed.(Default = no cap)" << endl;
+		cerr << "-cmem\tMemory cap of cached constraint bitmaps in MB.(Default = 64)" << endl;
+		cerr << "-tt\tNetworks kept in the score table of each run, 0 to turn off.(Default = 65536)" << endl;
 		cerr << "-i\tUse mutual information instead of Bayesian score (use logK parameter for penalty)" << endl;
 		cerr << endl << "Contact: \"Li Shen\"<shen@ucsd.edu>" << endl;
 		return 1;
@@ -51,8 +70,11 @@ int main(int argc, char* argv[])
 	try
 	{
 		s = cmdLine.GetArgument("-s", 0);	// score file.
-		n = cmdLine.GetArgument("-n", 0);	// node.
-		b = cmdLine.GetArgument("-b", 0);	// background.
+		if(!cmdLine.HasSwitch("-clusters"))
+		{
+			n = cmdLine.GetArgument("-n", 0);	// node.
+			b = cmdLine.GetArgument("-b", 0);	// background.
+		}
 		f = cmdLine.GetArgument("-f", 0);	// func depth.
 		o = cmdLine.GetArgument("-o", 0);	// output.
 	}
@@ -129,6 +151,33 @@ int main(int argc, char* argv[])
 
 	string bp = cmdLine.GetSafeArgument("-bp", 0, "");      // Output each gene's probability like in Beer's prediction.
 
+	string cv = cmdLine.GetSafeArgument("-cv", 0, "0");	// number of folds for cross validation in memory.
+	int cvk = atoi(cv.data());
+	string bs = cmdLine.GetSafeArgument("-bootstrap", 0, "0");	// number of bootstrap replicates in memory.
+	int bsn = atoi(bs.data());
+	string pm = cmdLine.GetSafeArgument("-perm", 0, "0");	// number of label permutations in memory.
+	int pmn = atoi(pm.data());
+	string ch = cmdLine.GetSafeArgument("-chains", 0, "");	// posterior sampling in memory.
+	int chm = cmdLine.HasSwitch("-chains")? ((ch != "")? atoi(ch.data()) : 4) : 0;
+	string chb = cmdLine.GetSafeArgument("-chains", 1, "1000");	// moves of burn-in.
+	string chn = cmdLine.GetSafeArgument("-chains", 2, "10000");	// samples of each chain.
+	string cht = cmdLine.GetSafeArgument("-chains", 3, "1.0");	// temperature; 1 samples the posterior.
+	string isl = cmdLine.GetSafeArgument("-island", 0, "");	// folder shared by islands.
+	string ig = cmdLine.GetSafeArgument("-island", 1, "1");	// repeats between migrations.
+	islgap = atoi(ig.data());
+	if(islgap < 1)
+		islgap = 1;
+	string mg = cmdLine.GetSafeArgument("-merge", 0, "");	// folder of islands to merge.
+	string ksw = cmdLine.GetSafeArgument("-k-sweep", 0, "");	// logK values to sweep in memory.
+	string sd = cmdLine.GetSafeArgument("-seed", 0, "1");	// seed of random numbers.
+	unsigned int seed = (unsigned int)atoi(sd.data());
+	setseed(seed);
+	string j = cmdLine.GetSafeArgument("-j", 0, "0");	// number of threads.
+	nthread = atoi(j.data());
+	string tl = cmdLine.GetSafeArgument("-time-limit", 0, "0");	// seconds of anytime search.
+	timelimit = atof(tl.data());
+	setdeadline();	// a killed job still ends with its best network.
+
 	// Simulated annealing parameters.
 	string strRep = cmdLine.GetSafeArgument("-sa", 0, "20");	// repeats.
 	string strIter = cmdLine.GetSafeArgument("-sa" , 1, "20");	// iterations.
@@ -146,6 +195,76 @@ int main(int argc, char* argv[])
 	Alpha = atof(strAlp.data());
 	Initemp = atof(strInit.data());
 	assert(Changes > Resthrld);	// max changes must be larger than threshold for restart.
+	if(cmdLine.HasSwitch("-mh"))	// random move kernel with proposals in each iteration.
+	{
+		mhkern = true;
+		string mh = cmdLine.GetSafeArgument("-mh", 0, "");
+		if(mh != "")
+			mhiter = atoi(mh.data());
+	}
+	if(cmdLine.HasSwitch("-asa"))	// adaptive schedule calibrated from the data.
+	{
+		adaptsa = true;
+		string acc = cmdLine.GetSafeArgument("-asa", 0, "");
+		if(acc != "")
+			tgtacc = atof(acc.data());
+		string pat = cmdLine.GetSafeArgument("-asa", 1, "");
+		if(pat != "")
+			patience = atol(pat.data());
+		if(tgtacc <= 0 || tgtacc >= 1)
+		{
+			cerr << "Target acceptance must be between 0 and 1!" << endl;
+			return 1;
+		}
+	}
+
+	if(cmdLine.HasSwitch("-pf"))
+		fetchtag = true;
+	string mem = cmdLine.GetSafeArgument("-mem", 0, "0");	// memory cap of binding in MB.
+	bndcap = (size_t)(atof(mem.data())*1048576);
+	string cmem = cmdLine.GetSafeArgument("-cmem", 0, "64");	// memory cap of constraint bitmaps in MB.
+	conscap = (size_t)(atof(cmem.data())*1048576);
+	string tt = cmdLine.GetSafeArgument("-tt", 0, "65536");	// networks kept in the score table.
+	netcap = (size_t)atoi(tt.data());
+
+	string cl = cmdLine.GetSafeArgument("-clusters", 0, "");	// folder of clusters for one-vs-rest.
+	if(cl != "")	// Candidates of each cluster are ranked from all motifs of the score file.
+	{
+		vector<string> motiflst, names;
+		vector<vector<string> > clus;
+		if(loadmotif(motiflst, s) != 0 || loadclus(cl, names, clus) != 0)
+		{
+			cerr << "Load motifs or clusters error!" << endl;
+			return 1;
+		}
+		set<string> genset;
+		for(size_t i = 0; i < clus.size(); i++)
+			genset.insert(clus[i].begin(), clus[i].end());
+		mkgidx(genset);
+		bfolder = f;
+		vector<MotifScore> vms(motiflst.size());
+		for(size_t i = 0; i < motiflst.size(); i++)
+			vms[i].name = motiflst[i];
+		if(chkbind(vms, f) != 0)
+		{
+			cerr << "Load binding information error!" << endl;
+			return 1;
+		}
+		ofstream hOut(o.data());
+		if(!hOut)
+		{
+			cerr << "Can't open " << o << endl;
+			return 1;
+		}
+		if(clusrun(hOut, o, gbnet, names, clus, motiflst, seed) != 0)
+		{
+			cerr << "One-vs-rest learning error!" << endl;
+			return 1;
+		}
+		outcache(hOut);
+		hOut.close();
+		return 0;
+	}
 
 	// Load and display motif scores.
 	if(loadscor(mscor, s) != 0)
@@ -187,18 +306,17 @@ int main(int argc, char* argv[])
 			genset.insert(rlst[i]);
 	}
 
-	// Load all genes' binding information.
-	if(loadbind(allbind, mscor, genset, f) != 0)
+	// Motif binding of genes in genset is loaded on first use.
+	mkgidx(genset);
+	setgidx(tlst);
+	setgidx(blst);
+	setgidx(genlst);
+	bfolder = f;
+	if(chkbind(mscor, f) != 0)
 	{
 		cerr << "Load binding information error!" << endl;
 		return 1;
 	}
-	else
-	{
-#ifdef VERBOSE
-		cout << "Load binding information completed!" << endl;
-#endif
-	}
 
 	// File for output.
 	ofstream hOut(o.data());
@@ -210,12 +328,107 @@ int main(int argc, char* argv[])
 	hOut << "Number of genes in category 1: " << tlst.size() << endl;
 	hOut << "Number of genes in category 0: " << blst.size() << endl << endl;
 
+	if(cvk > 0)	// Cross validation replaces learning on all genes.
+	{
+		ofstream hbp;
+		if(bp != "")
+		{
+			hbp.open(bp.data());
+			if(!hbp)
+			{
+				cerr << "Can't open " << bp << endl;
+				return 1;
+			}
+		}
+		if(cvrun(hOut, (bp != "")? &hbp : NULL, gbnet, tlst, blst, cvk, oscor, seed) != 0)
+		{
+			cerr << "Cross validation error!" << endl;
+			return 1;
+		}
+		outcache(hOut);
+		hOut.close();
+		return 0;
+	}
+	if(bsn > 0)	// Bootstrap replicates replace learning on all genes.
+	{
+		if(bootrun(hOut, gbnet, tlst, blst, bsn, oscor, seed) != 0)
+		{
+			cerr << "Bootstrap error!" << endl;
+			return 1;
+		}
+		outcache(hOut);
+		hOut.close();
+		return 0;
+	}
+	if(ksw != "")	// One network for each logK value.
+	{
+		vector<string> ks;
+		istringstream strmK(ksw);
+		string k1;
+		while(getline(strmK, k1, ','))
+		{
+			if(k1 != "")
+				ks.push_back(k1);
+		}
+		if(sweeprun(hOut, o, gbnet, tlst, blst, ks, oscor, seed, plst, nlst) != 0)
+		{
+			cerr << "logK sweep error!" << endl;
+			return 1;
+		}
+		outcache(hOut);
+		hOut.close();
+		return 0;
+	}
+	if(mg != "")	// Merge of island mode replaces learning.
+	{
+		if(mergerun(hOut, mg, genlst, oscor, tlst.size(), blst.size()) != 0)
+		{
+			cerr << "No network to merge in " << mg << endl;
+			return 1;
+		}
+		outcache(hOut);
+		hOut.close();
+		return 0;
+	}
+	if(chm > 0)	// Posterior sampling replaces learning one network.
+	{
+		if(chainrun(hOut, genlst, chm, atoi(chb.data()), atoi(chn.data()), atof(cht.data()), oscor, seed) != 0)
+		{
+			cerr << "Posterior sampling error!" << endl;
+			return 1;
+		}
+		outcache(hOut);
+		hOut.close();
+		return 0;
+	}
+	if(pmn > 0)	// Learning on all genes is followed by permutations.
+	{
+		if(permrun(hOut, gbnet, tlst, blst, pmn, oscor, seed) != 0)
+		{
+			cerr << "Permutation test error!" << endl;
+			return 1;
+		}
+		outcache(hOut);
+		hOut.close();
+		return 0;
+	}
+
 	vector<Constraint> cons;	// constraints.
 	vector<CPTRow> cpt;		// conditional probability table.
 	Temp = Initemp;	// Set temperature to initial value.
 	clock_t start = clock();
+	setsnap(o, oscor, tlst.size(), blst.size());
+	if(isl != "")	// Only the single run is an island.
+	{
+		isldir = isl;
+		islname = "island" + sd + ".net";
+	}
 	double scor = gbnet(cons, cpt, genlst);	// run Bayesian network.
 	clock_t finish = clock();
+	hOut.close();	// snapshots may have replaced the output file, so it is written again.
+	hOut.open(o.data());
+	hOut << "Number of genes in category 1: " << tlst.size() << endl;
+	hOut << "Number of genes in category 0: " << blst.size() << endl << endl;
 	if(outbayes(hOut, scor, cons, cpt, oscor, tlst.size(), blst.size()) != 0)	// output BN running results.
 	{
 		cerr << "Output Bayesian network results error!" << endl;
@@ -254,7 +467,10 @@ int main(int argc, char* argv[])
 			hbp.close();
 		}
 	}
+	if(timeup())
+		hOut << endl << "Search stopped at the time limit or on SIGTERM." << endl;
 	hOut << endl << "Bayesian network occupied CPU " << (double)(finish-start)/CLOCKS_PER_SEC << " seconds." << endl;
+	outcache(hOut);
 	hOut.close();
 
 	return 0;
@@ -33,15 +33,32 @@ const int loop_thrds[] = {1000, 2000, 3000, 4000, 5000};
 int nloopt = sizeof loop_thrds/sizeof loop_thrds[0];
 
 int motifcand = 50;	// maximum number of motifs to be included.
-double logK = 0.0;		// parameter for network structure prior.
+thread_local double logK = 0.0;		// parameter for network structure prior; kept for each thread as rb.
 int prior = 0;	// flag for setting prior counts for motifs that should be included into Bayesian networks.
 set<string> primo;	// map to store motifs that should be added to Bayesian network apriori.
 int pricnt = 20;	// prior counts for preferred motifs.
 map<string, int> mtss;	// map for translational(transcriptional) start sites.
-string rb = "111110";	// rule bit-string.
+thread_local string rb = "111110";	// rule bit-string.
 bool itag = false;	// Mutual information tag.
 
 MotifMap allbind;
-set<int> mbnd;
-vector<MotifScore> mscor;
+map<string, int> gidx;	// index of each gene in motif binding.
+vector<string> gnames;	// gene names in the order of index.
+string bfolder;	// folder of functional depth files to load binding from.
+bool fetchtag = false;	// Tag for loading the next candidate motif in background.
+size_t bndcap = 0;	// memory cap of motif binding in bytes; 0 means no cap.
+size_t conscap = 64*1048576;	// memory cap of cached constraint bitmaps in bytes.
+size_t netcap = 65536;	// networks kept in the table of each searching thread; 0 means no table.
+long exbudget = 10000000;	// networks visited by one exact search at most.
+double exsecs = 600;	// seconds of one exact search at most.
+double timelimit = 0;	// wall clock seconds from the start of the program to stop searches; 0 means no limit.
+string isldir;	// folder shared by the processes of island mode; empty if off.
+string islname;	// file of this process's best network in "isldir".
+int islgap = 1;	// repeats of annealing between migrations.
+int beamw = 5;	// networks kept at each step of beam search.
+int tabutn = 5;	// steps a reversed move stays tabu.
+int tabustep = 20;	// steps of tabu search without a better network before it stops.
+// Network being learned is kept for each thread so that runs can go in parallel.
+thread_local set<int> mbnd;
+thread_local vector<MotifScore> mscor;
 
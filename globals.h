@@ -21,17 +21,33 @@ extern int ndistt;
 extern const int loop_thrds[];
 extern int nloopt;
 extern int motifcand;
-extern double logK;
+extern thread_local double logK;
 extern int prior;
 extern set<string> primo;
 extern int pricnt;
 extern map<string, int> mtss;
-extern string rb;
+extern thread_local string rb;
 extern bool itag;
 // *********** Motif binding global variables **********
 extern MotifMap allbind;
-extern set<int> mbnd;
-extern vector<MotifScore> mscor;
+extern map<string, int> gidx;
+extern vector<string> gnames;
+extern string bfolder;
+extern bool fetchtag;
+extern size_t bndcap;
+extern size_t conscap;
+extern size_t netcap;
+extern long exbudget;
+extern double exsecs;
+extern double timelimit;
+extern string isldir;
+extern string islname;
+extern int islgap;
+extern int beamw;
+extern int tabutn;
+extern int tabustep;
+extern thread_local set<int> mbnd;
+extern thread_local vector<MotifScore> mscor;
 
 
 #define VERBOSE	// verbose mode.
@@ -0,0 +1,703 @@
+/*	multirun.cpp
+
+	Definitions of routines that learn many Bayesian networks in one
+	process over the same motif binding.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <map>
+#include <set>
+#include <algorithm>
+#include <random>
+#include <math.h>
+#include <stdlib.h>
+#include "multirun.h"
+#include "globals.h"
+#include "sa.h"
+#include "thrpool.h"
+
+// Learn one network on a gene list starting from the original motif scores.
+// The search state is reset for the calling thread, so runs can go in parallel.
+BSolu learnrun(BNEngine engine, const vector<Case>& genlst, const vector<MotifScore>& vms, unsigned int seed)
+{
+	initrun(vms);
+	setseed(seed);
+	BSolu r;
+	r.s = engine(r.cons, r.cpt, genlst);
+	r.mbnd = mbnd;
+	r.mscor = mscor;
+	return r;
+}
+
+// Split node and bkg lists into K folds as cvpart does: gene j goes to fold j%K.
+void cvsplit(const vector<Case>& tlst, const vector<Case>& blst, int K, int fold, 
+			 vector<Case>& trn, vector<Case>& ptst, vector<Case>& ntst)
+{
+	trn.clear();
+	ptst.clear();
+	ntst.clear();
+	for(size_t j = 0; j < tlst.size(); j++)
+	{
+		if((int)j%K == fold)
+			ptst.push_back(tlst[j]);
+		else
+			trn.push_back(tlst[j]);
+	}
+	for(size_t j = 0; j < blst.size(); j++)
+	{
+		if((int)j%K == fold)
+			ntst.push_back(blst[j]);
+		else
+			trn.push_back(blst[j]);
+	}
+}
+
+// K-fold cross validation in one process: learn each fold in parallel and 
+// predict its held-out genes. Return 0 if successful.
+int cvrun(ofstream& h, ofstream* hbp, BNEngine engine, const vector<Case>& tlst, const vector<Case>& blst, 
+		  int K, const vector<MotifScore>& vms, unsigned int seed)
+{
+	if(K < 2 || (size_t)K > tlst.size() || (size_t)K > blst.size())
+	{
+		cerr << "Number of folds must be between 2 and the size of node and bkg lists!" << endl;
+		return 1;
+	}
+	vector<BSolu> vr(K);	// network learned on each fold.
+	vector<Pred> vd(K);	// prediction on each fold.
+	vector<vector<BPred> > vbp(K);	// probabilities of held-out genes.
+	vector<double> vsec(K);	// seconds used by each fold.
+	RunConf conf = getconf();	// workers run with the settings of this thread.
+	parfor(K, [&](int i)
+	{
+		setconf(conf);
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		vector<Case> trn, ptst, ntst;
+		cvsplit(tlst, blst, K, i, trn, ptst, ntst);
+		vr[i] = learnrun(engine, trn, vms, seed + i);
+		vector<string> plst, nlst;
+		for(size_t j = 0; j < ptst.size(); j++)
+			plst.push_back(ptst[j].name);
+		for(size_t j = 0; j < ntst.size(); j++)
+			nlst.push_back(ntst[j].name);
+		vd[i] = predict(vr[i].cons, vr[i].cpt, plst, nlst);
+		vbp[i] = predict(vr[i].cons, vr[i].cpt, ptst, 1);
+		vector<BPred> nbp = predict(vr[i].cons, vr[i].cpt, ntst, 0);
+		vbp[i].insert(vbp[i].end(), nbp.begin(), nbp.end());
+		vsec[i] = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	});
+
+	h << endl << "**** Results of " << K << "-fold cross validation ****" << endl;
+	Pred tot = {0, 0, 0, 0};
+	for(int i = 0; i < K; i++)
+	{
+		h << endl << "Fold " << i + 1 << ": Bayesian score " << vr[i].s << " in " << vsec[i] << " seconds." << endl;
+		for(size_t j = 0; j < vr[i].cons.size(); j++)
+		{
+			h << j + 1 << ". ";
+			outcons(h, vr[i].cons[j], vr[i].mscor);
+		}
+		h << "TP\tFP\tTN\tFN" << endl;
+		h << vd[i].TP << "\t" << vd[i].FP << "\t" << vd[i].TN << "\t" << vd[i].FN << endl;
+		tot.TP += vd[i].TP;
+		tot.FP += vd[i].FP;
+		tot.TN += vd[i].TN;
+		tot.FN += vd[i].FN;
+	}
+	h << endl << "All folds:" << endl;
+	h << "TP\tFP\tTN\tFN" << endl;
+	h << tot.TP << "\t" << tot.FP << "\t" << tot.TN << "\t" << tot.FN << endl;
+	h << "Sensitivity: " << (double)tot.TP/(tot.TP + tot.FN) << endl;
+	h << "Specificity: " << (double)tot.TN/(tot.TN + tot.FP) << endl;
+	h << "Accuracy: " << (double)(tot.TP + tot.TN)/(tot.TP + tot.FP + tot.TN + tot.FN) << endl;
+
+	if(hbp != NULL)	// each held-out gene's probability being in this cluster.
+	{
+		for(int i = 0; i < K; i++)
+			outpred(*hbp, vbp[i]);
+	}
+
+	return 0;
+}
+
+// Networks visited by one chain, with consecutive equal ones stored once.
+struct ChainRec{
+	vector<string> cnames, mnames;	// names of constraints and motifs seen by the chain.
+	vector<vector<int> > cons, mots;	// constraints and motifs of each stored network.
+	vector<double> s;	// score of each stored network.
+	vector<int> len;	// times each stored network was sampled.
+	long acc;	// accepted moves after burn-in.
+	int n;		// samples taken; fewer than asked if stopped.
+};
+
+// Gelman-Rubin R-hat of a quantity sampled by several chains of equal length.
+// Return -1 if it can't be computed.
+static double rhat(const vector<vector<double> >& x)
+{
+	size_t M = x.size(), n = M? x[0].size() : 0;
+	if(M < 2 || n < 2)
+		return -1;
+	vector<double> m(M, 0);
+	double mm = 0, W = 0, B = 0;
+	for(size_t i = 0; i < M; i++)
+	{
+		for(size_t t = 0; t < n; t++)
+			m[i] += x[i][t];
+		m[i] /= n;
+		mm += m[i]/M;
+		double v = 0;
+		for(size_t t = 0; t < n; t++)
+			v += (x[i][t] - m[i])*(x[i][t] - m[i]);
+		W += v/(n - 1)/M;
+	}
+	for(size_t i = 0; i < M; i++)
+		B += (m[i] - mm)*(m[i] - mm)*n/(M - 1);
+	if(W == 0)
+		return (B == 0)? 1 : HUGE_VAL;
+	return sqrt(((n - 1)*W/n + B/n)/W);
+}
+
+// Index of a name in a list, appended if new.
+static int nameid(vector<string>& v, const string& s)
+{
+	vector<string>::const_iterator i = find(v.begin(), v.end(), s);
+	if(i != v.end())
+		return (int)(i - v.begin());
+	v.push_back(s);
+	return (int)v.size() - 1;
+}
+
+// Posterior sampling in one process: M chains of random moves at a fixed temperature 
+// run in parallel, each recording "N" networks after "burn" moves. At temperature 
+// 1 the chains sample networks in proportion to 10^score, the posterior. Inclusion 
+// probability of each constraint and motif and R-hat between chains are output 
+// to h. Chains stop at the time limit or on SIGTERM and are cut to the shortest one 
+// that took samples. Return 0 if successful.
+int chainrun(ofstream& h, const vector<Case>& genlst, int M, int burn, int N, double T, 
+			 const vector<MotifScore>& vms, unsigned int seed)
+{
+	if(M < 1 || N < 1 || burn < 0 || T <= 0)
+		return 1;
+	vector<ChainRec> vc(M);
+	RunConf conf = getconf();
+	parfor(M, [&](int i)
+	{
+		setconf(conf);
+		initrun(vms);
+		setseed(seed + i);
+		tagbests = false;
+		Temp = T;
+		ChainRec& r = vc[i];
+		r.acc = 0;
+		r.n = 0;
+		vector<Constraint> cons;
+		vector<CPTRow> cpt;
+		double s = addpres(0, cons, cpt, 1, genlst, true);	// Add first motif into Bayesian network.
+		for(int k = 0; k < burn && !timeup(); k++)
+			s = mhstep(cons, cpt, s, genlst);
+		for(; r.n < N && !timeup(); r.n++)
+		{
+			int c0 = chng;
+			s = mhstep(cons, cpt, s, genlst);
+			r.acc += chng - c0;
+			set<int> cs, ms;
+			for(size_t j = 0; j < cons.size(); j++)
+				cs.insert(nameid(r.cnames, consname(cons[j], mscor)));
+			for(set<int>::const_iterator m = mbnd.begin(); m != mbnd.end(); m++)
+				ms.insert(nameid(r.mnames, mscor[*m].name));
+			vector<int> vcs(cs.begin(), cs.end()), vmt(ms.begin(), ms.end());
+			if(!r.len.empty() && r.cons.back() == vcs && r.mots.back() == vmt && r.s.back() == s)
+				r.len.back()++;
+			else
+			{
+				r.cons.push_back(vcs);
+				r.mots.push_back(vmt);
+				r.s.push_back(s);
+				r.len.push_back(1);
+			}
+		}
+		waitfetch();
+	});
+
+	// Chains stopped at the time limit or on SIGTERM are cut to the shortest one; 
+	// chains that took no sample are left out.
+	int M0 = M, n = N;
+	vector<ChainRec> vt;
+	for(int i = 0; i < M0; i++)
+	{
+		if(vc[i].n > 0)
+		{
+			vt.push_back(vc[i]);
+			n = min(n, vc[i].n);
+		}
+	}
+	vc.swap(vt);
+	M = (int)vc.size();
+	if(M < 1)
+	{
+		h << endl << "**** No samples of " << M0 << " chains before the time limit or SIGTERM ****" << endl;
+		return 0;
+	}
+
+	// Indicators of each constraint and motif over the samples of each chain.
+	map<string, vector<vector<double> > > ic, im;
+	vector<vector<double> > vs(M);
+	for(int i = 0; i < M; i++)
+	{
+		for(size_t j = 0; j < vc[i].cnames.size(); j++)
+			ic[vc[i].cnames[j]].assign(M, vector<double>(n, 0));
+		for(size_t j = 0; j < vc[i].mnames.size(); j++)
+			im[vc[i].mnames[j]].assign(M, vector<double>(n, 0));
+	}
+	for(int i = 0; i < M; i++)
+	{
+		const ChainRec& r = vc[i];
+		int t = 0;
+		for(size_t j = 0; j < r.len.size() && t < n; t += r.len[j], j++)
+		{
+			for(int l = t; l < t + r.len[j] && l < n; l++)
+			{
+				vs[i].push_back(r.s[j]);
+				for(size_t c = 0; c < r.cons[j].size(); c++)
+					ic[r.cnames[r.cons[j][c]]][i][l] = 1;
+				for(size_t c = 0; c < r.mots[j].size(); c++)
+					im[r.mnames[r.mots[j][c]]][i][l] = 1;
+			}
+		}
+	}
+
+	h << endl << "**** Results of " << M << " chains at temperature " << T << " ****" << endl;
+	h << "Burn-in: " << burn << " moves; samples of each chain: " << n;
+	if(n < N || M < M0)
+		h << " of " << N << "; stopped at the time limit or on SIGTERM with " << M << " of " << M0 << " chains sampled";
+	h << endl;
+	h << endl << "Chain\tMean score\tAcceptance\tStored networks" << endl;
+	vector<double> all;
+	for(int i = 0; i < M; i++)
+	{
+		double m = 0;
+		for(int t = 0; t < n; t++)
+			m += vs[i][t]/n;
+		h << i + 1 << "\t" << m << "\t" << (double)vc[i].acc/vc[i].n << "\t" << vc[i].len.size() << endl;
+		all.insert(all.end(), vs[i].begin(), vs[i].end());
+	}
+	h << endl << "Distribution of Bayesian score:" << endl;
+	outdist(h, all);
+	double rs = rhat(vs);
+	h << "R-hat: ";
+	if(rs < 0)
+		h << "NA" << endl;
+	else
+		h << rs << endl;
+	for(int k = 0; k < 2; k++)
+	{
+		const map<string, vector<vector<double> > >& ind = (k == 0)? ic : im;
+		vector<pair<double, string> > vp;	// inclusion probability of each name.
+		for(map<string, vector<vector<double> > >::const_iterator i = ind.begin(); i != ind.end(); i++)
+		{
+			double p = 0;
+			for(int c = 0; c < M; c++)
+			{
+				for(int t = 0; t < n; t++)
+					p += i->second[c][t];
+			}
+			vp.push_back(make_pair(p/M/n, i->first));
+		}
+		stable_sort(vp.begin(), vp.end(), [](const pair<double, string>& a, const pair<double, string>& b) { return a.first > b.first; });
+		h << endl << "Inclusion probability of " << ((k == 0)? "constraints" : "motifs") << ":" << endl;
+		h << "Name\tProbability\tR-hat" << endl;
+		for(size_t i = 0; i < vp.size(); i++)
+		{
+			double r = rhat(ind.find(vp[i].second)->second);
+			h << vp[i].second << "\t" << vp[i].first << "\t";
+			if(r < 0)
+				h << "NA" << endl;
+			else
+				h << r << endl;
+		}
+	}
+
+	return 0;
+}
+
+// Merge of island mode: the networks published in folder dir are scored again on 
+// genlst and the best one is output to h as a single run. Return 0 if successful.
+int mergerun(ofstream& h, const string& dir, const vector<Case>& genlst, const vector<MotifScore>& vms, 
+			 size_t node, size_t bkg)
+{
+	initrun(vms);
+	vector<string> v;
+	netfiles(dir, v);
+	BSolu best;
+	best.s = 1;
+	string bf;
+	h << "Island\tPublished score\tVerified score" << endl;
+	for(size_t i = 0; i < v.size(); i++)
+	{
+		BSolu b;
+		if(loadnet(v[i], b) != 0)
+		{
+			h << v[i] << "\tunreadable" << endl;
+			continue;
+		}
+		mscor = b.mscor;
+		double s = evalnet(b.cpt, genlst, b.cons);
+		h << v[i] << "\t" << b.s << "\t" << s;
+		if(fabs(s - b.s) > 1e-6*fabs(b.s))	// learned on other data or options.
+		{
+			h << "\tignored" << endl;
+			continue;
+		}
+		h << endl;
+		b.s = s;
+		if(best.s == 1 || s > best.s)
+		{
+			best = b;
+			bf = v[i];
+		}
+	}
+	if(best.s == 1)
+		return 1;
+	h << endl << "Best network: " << bf << endl << endl;
+	mscor = best.mscor;
+	mbnd = best.mbnd;
+	tagbests = false;
+
+	return outbayes(h, best.s, best.cons, best.cpt, vms, node, bkg);
+}
+
+// Name of a constraint regardless of its parameter and depths.
+// Motifs of symmetric rules are put in alphabetical order.
+string consname(const Constraint& c, const vector<MotifScore>& vms)
+{
+	string m0 = vms[c.motif0].name;
+	if(c.motif1 == -1)
+		return c.desc + " of " + m0;
+	string m1 = vms[c.motif1].name;
+	if(c.desc == "order")
+	{
+		if(c.para == 1)
+			swap(m0, m1);
+		return m0 + " before " + m1;
+	}
+	if(m1 < m0)
+		swap(m0, m1);
+	return c.desc + " of " + m0 + " and " + m1;
+}
+
+// Output mean, standard deviation and quantiles of a set of scores.
+void outdist(ofstream& h, vector<double> v)
+{
+	if(v.empty())
+		return;
+	sort(v.begin(), v.end());
+	double m = 0, sd = 0;
+	for(size_t i = 0; i < v.size(); i++)
+		m += v[i];
+	m /= v.size();
+	for(size_t i = 0; i < v.size(); i++)
+		sd += (v[i] - m)*(v[i] - m);
+	if(v.size() > 1)
+		sd = sqrt(sd/(v.size() - 1));
+	h << "Mean: " << m << "\tSD: " << sd << endl;
+	h << "Min\t25%\tMedian\t75%\tMax" << endl;
+	h << v.front() << "\t" << v[(v.size() - 1)/4] << "\t" << v[(v.size() - 1)/2] << "\t" 
+		<< v[(v.size() - 1)*3/4] << "\t" << v.back() << endl;
+}
+
+// Bootstrap in one process: each replicate weights node and bkg genes by 
+// their multiplicity in a resample and is learned in parallel. Return 0 if successful.
+int bootrun(ofstream& h, BNEngine engine, const vector<Case>& tlst, const vector<Case>& blst, 
+			int N, const vector<MotifScore>& vms, unsigned int seed)
+{
+	if(N < 1)
+	{
+		cerr << "Number of bootstrap replicates must be positive!" << endl;
+		return 1;
+	}
+	vector<BSolu> vr(N);	// network learned on each replicate.
+	RunConf conf = getconf();
+	parfor(N, [&](int i)
+	{
+		setconf(conf);
+		setseed(seed + i);
+		vector<Case> genlst = bsamp(tlst, blst);
+		vr[i] = learnrun(engine, genlst, vms, seed + i);
+	});
+
+	map<string, int> ncons;	// times each constraint is selected.
+	map<string, int> nmotif;	// times each motif is in network.
+	vector<double> vs;
+	for(int i = 0; i < N; i++)
+	{
+		set<string> cs, ms;	// count each once per replicate.
+		for(size_t j = 0; j < vr[i].cons.size(); j++)
+		{
+			const Constraint& c = vr[i].cons[j];
+			cs.insert(consname(c, vr[i].mscor));
+			ms.insert(vr[i].mscor[c.motif0].name);
+			if(c.motif1 != -1)
+				ms.insert(vr[i].mscor[c.motif1].name);
+		}
+		for(set<string>::const_iterator k = cs.begin(); k != cs.end(); k++)
+			ncons[*k]++;
+		for(set<string>::const_iterator k = ms.begin(); k != ms.end(); k++)
+			nmotif[*k]++;
+		vs.push_back(vr[i].s);
+	}
+
+	h << endl << "**** Results of " << N << " bootstrap replicates ****" << endl;
+	h << endl << "Bayesian score of each replicate:" << endl;
+	for(int i = 0; i < N; i++)
+		h << i + 1 << "\t" << vr[i].s << "\t" << vr[i].cons.size() << endl;
+	h << endl << "Distribution of Bayesian score:" << endl;
+	outdist(h, vs);
+	h << endl << "Selection frequency of constraints:" << endl;
+	for(map<string, int>::const_iterator k = ncons.begin(); k != ncons.end(); k++)
+		h << k->first << "\t" << (double)k->second/N << endl;
+	h << endl << "Selection frequency of motifs:" << endl;
+	for(map<string, int>::const_iterator k = nmotif.begin(); k != nmotif.end(); k++)
+		h << k->first << "\t" << (double)k->second/N << endl;
+
+	return 0;
+}
+
+// Permutation test in one process: node and bkg labels are shuffled among all 
+// genes and each permutation is learned in parallel. Constraint bitmaps do not 
+// depend on labels and are shared by all runs. Return 0 if successful.
+int permrun(ofstream& h, BNEngine engine, const vector<Case>& tlst, const vector<Case>& blst, 
+			int N, const vector<MotifScore>& vms, unsigned int seed)
+{
+	if(N < 1)
+	{
+		cerr << "Number of permutations must be positive!" << endl;
+		return 1;
+	}
+	vector<Case> genlst = tlst;
+	genlst.insert(genlst.end(), blst.begin(), blst.end());
+	BSolu obs = learnrun(engine, genlst, vms, seed);	// network on the real labels.
+
+	vector<double> vs(N);	// score of each permutation.
+	vector<int> vn(N);	// number of constraints of each permutation.
+	RunConf conf = getconf();
+	parfor(N, [&](int i)
+	{
+		setconf(conf);
+		vector<int> lab(genlst.size());
+		for(size_t j = 0; j < genlst.size(); j++)
+			lab[j] = genlst[j].label;
+		mt19937 g(seed + i + 1);
+		shuffle(lab.begin(), lab.end(), g);
+		vector<Case> plst = genlst;
+		for(size_t j = 0; j < plst.size(); j++)
+			plst[j].label = lab[j];
+		BSolu r = learnrun(engine, plst, vms, seed + i + 1);
+		vs[i] = r.s;
+		vn[i] = (int)r.cons.size();
+	});
+
+	int nge = 0;	// permutations scoring at least the real labels.
+	for(int i = 0; i < N; i++)
+	{
+		if(vs[i] >= obs.s)
+			nge++;
+	}
+
+	h << "Bayesian score: " << obs.s << endl;
+	for(size_t j = 0; j < obs.cons.size(); j++)
+	{
+		h << j + 1 << ". ";
+		outcons(h, obs.cons[j], obs.mscor);
+	}
+	h << endl << "**** Results of " << N << " label permutations ****" << endl;
+	h << endl << "Bayesian score of each permutation:" << endl;
+	for(int i = 0; i < N; i++)
+		h << i + 1 << "\t" << vs[i] << "\t" << vn[i] << endl;
+	h << endl << "Distribution of Bayesian score:" << endl;
+	outdist(h, vs);
+	h << endl << "Permutations scoring at least the real labels: " << nge << endl;
+	h << "Empirical p-value: " << (double)(nge + 1)/(N + 1) << endl;
+
+	return 0;
+}
+
+// Load clusters listed in "BGNnh.txt" of a folder as corrbkg reads them: 
+// one cluster name per line and its genes in "name.lst". Return 0 if successful.
+int loadclus(const string& folder, vector<string>& names, vector<vector<string> >& clus)
+{
+	if(get1stcol(folder + "/BGNnh.txt", names) < 0)
+		return 1;
+	clus.resize(names.size());
+	for(size_t i = 0; i < names.size(); i++)
+	{
+		vector<string> lst;
+		if(get1stcol(folder + "/" + names[i] + ".lst", lst) < 0)
+			return 1;
+		set<string> seen;	// a gene is counted once per cluster.
+		for(size_t j = 0; j < lst.size(); j++)
+		{
+			str2upper(lst[j]);
+			if(seen.insert(lst[j]).second)
+				clus[i].push_back(lst[j]);
+		}
+	}
+	return 0;
+}
+
+// One-vs-rest learning in one process: each cluster is the node list and the 
+// genes of all other clusters are the bkg list. Candidate motifs are ranked on 
+// each cluster by presence score, then the network is learned; clusters go in 
+// parallel and share the binding and constraint bitmaps since only labels differ.
+// Each network is written to "o.name" and a summary to h. Return 0 if successful.
+int clusrun(ofstream& h, const string& o, BNEngine engine, const vector<string>& names, 
+			const vector<vector<string> >& clus, const vector<string>& motiflst, unsigned int seed)
+{
+	int N = (int)names.size();
+	vector<BSolu> vr(N);	// network learned on each cluster.
+	vector<vector<MotifScore> > vms(N);	// candidate motifs of each cluster.
+	vector<size_t> nnode(N), nbkg(N);
+	vector<double> vsec(N);	// seconds used by each cluster.
+	vector<int> vok(N, 1);	// output file is written.
+	RunConf conf = getconf();
+	parfor(N, [&](int i)
+	{
+		setconf(conf);
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		set<string> node(clus[i].begin(), clus[i].end());
+		vector<Case> genlst;
+		for(size_t g = 0; g < gnames.size(); g++)	// all genes of the clusters.
+		{
+			Case c;
+			c.name = gnames[g];
+			c.label = node.count(gnames[g])? 1 : 0;
+			c.gi = (int)g;
+			c.wt = 1;
+			genlst.push_back(c);
+		}
+		nnode[i] = node.size();
+		nbkg[i] = genlst.size() - node.size();
+
+		for(size_t j = 0; j < motiflst.size(); j++)
+			vms[i].push_back(presscor(motiflst[j], genlst));
+		sort(vms[i].begin(), vms[i].end(), cmp);
+		if((int)vms[i].size() > motifcand)
+			vms[i].erase(vms[i].begin() + motifcand, vms[i].end());
+
+		vr[i] = learnrun(engine, genlst, vms[i], seed);
+		vsec[i] = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+		// Written by the worker, whose best solutions and settings belong to this cluster.
+		string fOut = o + "." + names[i];
+		ofstream hOut(fOut.data());
+		if(!hOut)
+		{
+			cerr << "Can't open " << fOut << endl;
+			vok[i] = 0;
+			return;
+		}
+		hOut << "Number of genes in category 1: " << nnode[i] << endl;
+		hOut << "Number of genes in category 0: " << nbkg[i] << endl << endl;
+		if(outbayes(hOut, vr[i].s, vr[i].cons, vr[i].cpt, vms[i], nnode[i], nbkg[i]) != 0)
+		{
+			cerr << "Output Bayesian network results error!" << endl;
+			vok[i] = 0;
+		}
+		hOut.close();
+	});
+
+	h << "Number of clusters: " << N << endl;
+	h << "Number of genes in all clusters: " << gnames.size() << endl << endl;
+	h << "Cluster\tNode\tBkg\tScore\tConstraints\tSeconds" << endl;
+	for(int i = 0; i < N; i++)
+	{
+		h << names[i] << "\t" << nnode[i] << "\t" << nbkg[i] << "\t" << vr[i].s << "\t" 
+			<< vr[i].cons.size() << "\t" << vsec[i] << endl;
+	}
+	for(int i = 0; i < N; i++)
+	{
+		if(!vok[i])
+			return 1;
+	}
+
+	return 0;
+}
+
+// Penalty sweep in one process: the network is learned for each logK value in 
+// parallel over the same data and caches. Each network is written to "o.logK" and 
+// a summary to h. Accuracy is on the testing lists if given, else on training genes.
+// Return 0 if successful.
+int sweeprun(ofstream& h, const string& o, BNEngine engine, const vector<Case>& tlst, const vector<Case>& blst, 
+			 const vector<string>& ks, const vector<MotifScore>& vms, unsigned int seed, 
+			 const vector<string>& plst, const vector<string>& nlst)
+{
+	int N = (int)ks.size();
+	if(N < 1)
+	{
+		cerr << "No logK value to sweep!" << endl;
+		return 1;
+	}
+	vector<Case> genlst = tlst;
+	genlst.insert(genlst.end(), blst.begin(), blst.end());
+	vector<string> ptst = plst, ntst = nlst;	// genes to compute accuracy.
+	if(ptst.empty() || ntst.empty())
+	{
+		ptst.clear();
+		ntst.clear();
+		for(size_t j = 0; j < tlst.size(); j++)
+			ptst.push_back(tlst[j].name);
+		for(size_t j = 0; j < blst.size(); j++)
+			ntst.push_back(blst[j].name);
+	}
+
+	vector<BSolu> vr(N);	// network learned for each value.
+	vector<Pred> vd(N);
+	vector<double> vsec(N);
+	vector<int> vok(N, 1);	// output file is written.
+	RunConf conf = getconf();
+	parfor(N, [&](int i)
+	{
+		setconf(conf);
+		logK = atof(ks[i].data());
+		if(tagbests)	// gbnet's deteriorate condition follows logK.
+			DeterScor = logK;
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		vr[i] = learnrun(engine, genlst, vms, seed);
+		vd[i] = predict(vr[i].cons, vr[i].cpt, ptst, ntst);
+		vsec[i] = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+		string fOut = o + "." + ks[i];
+		ofstream hOut(fOut.data());
+		if(!hOut)
+		{
+			cerr << "Can't open " << fOut << endl;
+			vok[i] = 0;
+			return;
+		}
+		hOut << "Number of genes in category 1: " << tlst.size() << endl;
+		hOut << "Number of genes in category 0: " << blst.size() << endl << endl;
+		if(outbayes(hOut, vr[i].s, vr[i].cons, vr[i].cpt, vms, tlst.size(), blst.size()) != 0)
+			vok[i] = 0;
+		hOut.close();
+	});
+
+	h << "**** Results of " << N << " logK values ****" << endl;
+	h << "Accuracy on " << ((plst.empty() || nlst.empty())? "training" : "testing") << " genes." << endl << endl;
+	h << "logK\tScore\tConstraints\tTP\tFP\tTN\tFN\tAccuracy\tSeconds" << endl;
+	for(int i = 0; i < N; i++)
+	{
+		const Pred& d = vd[i];
+		h << ks[i] << "\t" << vr[i].s << "\t" << vr[i].cons.size() << "\t" << d.TP << "\t" << d.FP << "\t" 
+			<< d.TN << "\t" << d.FN << "\t" << (double)(d.TP + d.TN)/(d.TP + d.FP + d.TN + d.FN) << "\t" 
+			<< vsec[i] << endl;
+	}
+	for(int i = 0; i < N; i++)
+	{
+		if(!vok[i])
+			return 1;
+	}
+
+	return 0;
+}
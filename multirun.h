@@ -0,0 +1,75 @@
+/*	multirun.h
+
+	Declarations of routines that learn many Bayesian networks in one
+	process over the same motif binding.
+*/
+
+#ifndef MULTIRUN_H
+#define MULTIRUN_H
+
+#include <fstream>
+#include <vector>
+#include <string>
+#include "badefs.h"
+#include "bayesub.h"
+
+using namespace std;
+
+// Learn one network on a gene list starting from the original motif scores.
+BSolu learnrun(BNEngine engine, const vector<Case>& genlst, const vector<MotifScore>& vms, unsigned int seed);
+
+// Split node and bkg lists into K folds as cvpart does: gene j goes to fold j%K.
+void cvsplit(const vector<Case>& tlst, const vector<Case>& blst, int K, int fold, 
+			 vector<Case>& trn, vector<Case>& ptst, vector<Case>& ntst);
+
+// K-fold cross validation in one process: learn each fold in parallel and 
+// predict its held-out genes. Return 0 if successful.
+int cvrun(ofstream& h, ofstream* hbp, BNEngine engine, const vector<Case>& tlst, const vector<Case>& blst, 
+		  int K, const vector<MotifScore>& vms, unsigned int seed);
+
+// Bootstrap in one process: each replicate weights node and bkg genes by 
+// their multiplicity in a resample and is learned in parallel. Return 0 if successful.
+int bootrun(ofstream& h, BNEngine engine, const vector<Case>& tlst, const vector<Case>& blst, 
+			int N, const vector<MotifScore>& vms, unsigned int seed);
+
+// Permutation test in one process: node and bkg labels are shuffled among all 
+// genes and each permutation is learned in parallel. Return 0 if successful.
+int permrun(ofstream& h, BNEngine engine, const vector<Case>& tlst, const vector<Case>& blst, 
+			int N, const vector<MotifScore>& vms, unsigned int seed);
+
+// Load clusters listed in "BGNnh.txt" of a folder as corrbkg reads them.
+// Return 0 if successful.
+int loadclus(const string& folder, vector<string>& names, vector<vector<string> >& clus);
+
+// One-vs-rest learning in one process: each cluster against the genes of all 
+// other clusters, in parallel. Each network is written to "o.name" and a summary 
+// to h. Return 0 if successful.
+int clusrun(ofstream& h, const string& o, BNEngine engine, const vector<string>& names, 
+			const vector<vector<string> >& clus, const vector<string>& motiflst, unsigned int seed);
+
+// Penalty sweep in one process: the network is learned for each logK value in 
+// parallel. Each network is written to "o.logK" and a summary to h. 
+// Return 0 if successful.
+int sweeprun(ofstream& h, const string& o, BNEngine engine, const vector<Case>& tlst, const vector<Case>& blst, 
+			 const vector<string>& ks, const vector<MotifScore>& vms, unsigned int seed, 
+			 const vector<string>& plst, const vector<string>& nlst);
+
+// Posterior sampling in one process: M chains of random moves at a fixed temperature 
+// run in parallel, each recording "N" networks after "burn" moves. Inclusion 
+// probability of each constraint and motif and R-hat between chains are output 
+// to h. Return 0 if successful.
+int chainrun(ofstream& h, const vector<Case>& genlst, int M, int burn, int N, double T, 
+			 const vector<MotifScore>& vms, unsigned int seed);
+
+// Merge of island mode: the networks published in folder dir are scored again on 
+// genlst and the best one is output to h as a single run. Return 0 if successful.
+int mergerun(ofstream& h, const string& dir, const vector<Case>& genlst, const vector<MotifScore>& vms, 
+			 size_t node, size_t bkg);
+
+// Name of a constraint regardless of its parameter and depths.
+string consname(const Constraint& c, const vector<MotifScore>& vms);
+
+// Output mean, standard deviation and quantiles of a set of scores.
+void outdist(ofstream& h, vector<double> v);
+
+#endif
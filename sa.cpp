@@ -7,21 +7,29 @@
 #include "badefs.h"
 
 // Simulated annealing.
-int Repeat = 40;	// Number of repeats. Each repeat corresponds to one temperature change.
-int Iteration = 20;	// Number of iterations. Each iteration corresponds to a traverse of all candidate motifs.
-int Changes = 500;	// Number of requried changes. If this is met, procedure goes to the next repeat.
-double Alpha = 0.9;	// Parameter to control the rate of temperature change.
-double Initemp = 10.0;	// Initial temperature.
-double Temp = Initemp;	// Current temperature to control the jumping rate.
-int chng = 0;	// counter for network structure changes.
+thread_local int Repeat = 40;	// Number of repeats. Each repeat corresponds to one temperature change.
+thread_local int Iteration = 20;	// Number of iterations. Each iteration corresponds to a traverse of all candidate motifs.
+thread_local int Changes = 500;	// Number of requried changes. If this is met, procedure goes to the next repeat.
+thread_local double Alpha = 0.9;	// Parameter to control the rate of temperature change.
+thread_local double Initemp = 10.0;	// Initial temperature.
+thread_local double Temp = Initemp;	// Current temperature to control the jumping rate.
+thread_local int chng = 0;	// counter for network structure changes.
 int maxpa = 5;	// Maximum number of parents.
 int DeterNum = 5;	// Number of genes satisfying constraints to determine deteriorate condition.
-double DeterScor = 0;	// Difference of scores between current and best to determine deteriorate condition.
-bool Restag = false;	// Tag to determine when to restart SA if bad condition happens.
+thread_local double DeterScor = 0;	// Difference of scores between current and best to determine deteriorate condition.
+thread_local bool Restag = false;	// Tag to determine when to restart SA if bad condition happens.
 int Resthrld = 200;	// Threshold of changes to set "Restag".
 int Restarts = 10;	// Maximum number of restarts for each temperature.
-int rests = 0;	// counter for restarts at each temperature. 
+thread_local int rests = 0;	// counter for restarts at each temperature. 
+bool mhkern = false;	// Propose one random move at a time instead of trying all.
+int mhiter = 100;	// Number of proposals in each iteration of the random move kernel.
+bool adaptsa = false;	// Calibrate initial temperature and cool by the acceptance of worse networks.
+double tgtacc = 0.1;	// Target acceptance ratio of worse networks in each repeat of the adaptive schedule.
+double iniacc = 0.2;	// Acceptance ratio of worse networks at the calibrated initial temperature.
+long patience = 50000;	// Networks evaluated without a better one before the adaptive schedule stops; 0 never stops.
+thread_local long nevals = 0;	// counter for networks evaluated.
+thread_local double calitemp = 0;	// Initial temperature calibrated by the adaptive schedule.
 
 // Best solution.
-struct BSolu bsolu;	// A structure to store the best solution found.
-bool tagbests = false;	// Do not use best solution as default.
+thread_local struct BSolu bsolu;	// A structure to store the best solution found.
+thread_local bool tagbests = false;	// Do not use best solution as default.
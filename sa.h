@@ -7,27 +7,36 @@
 #define SA_H
 
 // Simulated Annealing.
-extern int Repeat;
-extern int Iteration;
-extern int Changes;
-extern double Alpha;
-extern double Initemp;
-extern double Temp;
-extern int chng;	// Counter: changes of BN.
+// Settings below are kept for each thread so that runs with different settings can go in parallel.
+extern thread_local int Repeat;
+extern thread_local int Iteration;
+extern thread_local int Changes;
+extern thread_local double Alpha;
+extern thread_local double Initemp;
+extern thread_local double Temp;
+extern thread_local int chng;	// Counter: changes of BN.
 extern int maxpa;
 extern int DeterNum;
-extern double DeterScor;
-extern bool Restag;
+extern thread_local double DeterScor;
+extern thread_local bool Restag;
 extern int Resthrld;
 extern int Restarts;
-extern int rests;
+extern thread_local int rests;
+extern bool mhkern;
+extern int mhiter;
+extern bool adaptsa;
+extern double tgtacc;
+extern double iniacc;
+extern long patience;
+extern thread_local long nevals;	// Counter: networks evaluated.
+extern thread_local double calitemp;
 
 // Best solution.
 struct BSolu;
-extern struct BSolu bsolu;
+extern thread_local struct BSolu bsolu;
 
 // Tag for using best solution data structure.
-extern bool tagbests;
+extern thread_local bool tagbests;
 
 #endif
 
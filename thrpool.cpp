@@ -0,0 +1,93 @@
+/*	thrpool.cpp
+
+	Definitions of a small pool of worker threads for parallel jobs.
+*/
+
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include "thrpool.h"
+
+int nthread = 0;	// number of worker threads; 0 means one per core.
+static thread_local bool inpool = false;	// the calling thread is a worker.
+
+// Number of worker threads to use for n jobs.
+int poolsize(int n)
+{
+	int nt = nthread;
+	if(nt <= 0)
+		nt = (int)thread::hardware_concurrency();
+	if(nt <= 0)
+		nt = 1;
+	return (nt < n)? nt : n;
+}
+
+// Whether the calling thread is a worker of the pool.
+bool pooljob()
+{
+	return inpool;
+}
+
+// Jobs waiting on one worker.
+struct JobQueue{
+	mutex m;
+	deque<int> q;
+};
+
+// Take the next job of a worker from the front of its own queue, or else
+// steal one from the back of another worker's queue. Return -1 if none is left.
+static int takejob(vector<JobQueue>& qs, int w)
+{
+	{
+		lock_guard<mutex> lk(qs[w].m);
+		if(!qs[w].q.empty())
+		{
+			int i = qs[w].q.front();
+			qs[w].q.pop_front();
+			return i;
+		}
+	}
+	for(size_t k = 1; k < qs.size(); k++)
+	{
+		JobQueue& v = qs[(w + k)%qs.size()];
+		lock_guard<mutex> lk(v.m);
+		if(!v.q.empty())
+		{
+			int i = v.q.back();
+			v.q.pop_back();
+			return i;
+		}
+	}
+	return -1;
+}
+
+// Run job(i) for all i in [0, n) on worker threads.
+void parfor(int n, const function<void(int)>& job)
+{
+	int nt = poolsize(n);
+	if(nt <= 1 || inpool)	// run in the calling thread; jobs of a worker are not split again.
+	{
+		for(int i = 0; i < n; i++)
+			job(i);
+		return;
+	}
+	vector<JobQueue> qs(nt);
+	for(int t = 0; t < nt; t++)	// each worker starts with a contiguous block.
+	{
+		for(int i = (int)((long long)n*t/nt); i < (int)((long long)n*(t + 1)/nt); i++)
+			qs[t].q.push_back(i);
+	}
+	vector<thread> workers;
+	for(int t = 0; t < nt; t++)
+	{
+		workers.push_back(thread([&qs, &job, t]()
+		{
+			inpool = true;
+			for(int i = takejob(qs, t); i >= 0; i = takejob(qs, t))
+				job(i);
+		}));
+	}
+	for(size_t t = 0; t < workers.size(); t++)
+		workers[t].join();
+}
@@ -0,0 +1,28 @@
+/*	thrpool.h
+
+	Declarations of a small pool of worker threads for parallel jobs.
+*/
+
+#ifndef THRPOOL_H
+#define THRPOOL_H
+
+#include <functional>
+
+using namespace std;
+
+// Number of worker threads; 0 means one per core.
+extern int nthread;
+
+// Number of worker threads to use for n jobs.
+int poolsize(int n);
+
+// Whether the calling thread is a worker of the pool.
+bool pooljob();
+
+// Run job(i) for all i in [0, n) on worker threads.
+// Each worker starts with a block of jobs and steals from others when its 
+// own run out, so that long and short jobs balance. A parfor inside a job 
+// runs in its worker.
+void parfor(int n, const function<void(int)>& job);
+
+#endif